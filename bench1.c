@@ -0,0 +1,173 @@
+// bench1.c - PR_SET_PGTABLE_REPL enable/disable latency vs. RSS
+// Populates anonymous memory from 1MB up to 64GB and times the enable and
+// disable prctl() calls for every node-mask width. Falls back to a stock
+// kernel baseline (timing the rejected prctl) when the call returns EINVAL.
+//
+// Usage: ./bench1 [max_rss_mb] [runs]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define MB (1024UL * 1024UL)
+#define GB (1024UL * MB)
+#define DEFAULT_RUNS 50
+#define MAX_MASKS 64
+
+static const size_t rss_buckets[] = {
+    1 * MB, 16 * MB, 256 * MB, 1 * GB, 4 * GB, 16 * GB, 64 * GB
+};
+#define NUM_BUCKETS (sizeof(rss_buckets) / sizeof(rss_buckets[0]))
+
+static void *populate(size_t size) {
+    char *mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem == MAP_FAILED) {
+        return NULL;
+    }
+    madvise(mem, size, MADV_NOHUGEPAGE);
+
+    // Touch every page so the page-table tree covers the full RSS
+    for (size_t i = 0; i < size; i += PAGE_SIZE) {
+        mem[i] = (char)(i >> 12);
+    }
+    return mem;
+}
+
+int main(int argc, char **argv) {
+    size_t max_rss = 64 * GB;
+    int runs = DEFAULT_RUNS;
+    unsigned long masks[MAX_MASKS];
+    int num_masks = 0;
+    int num_nodes = 1;
+    int baseline = 0;
+
+    if (argc > 1) {
+        max_rss = strtoul(argv[1], NULL, 0) * MB;
+    }
+    if (argc > 2) {
+        runs = atoi(argv[2]);
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+
+    mt_init("bench1");
+    printf("Bench1: Replication Enable/Disable Latency vs. RSS\n");
+    printf("==================================================\n");
+
+    if (numa_available() >= 0) {
+        num_nodes = numa_num_configured_nodes();
+    }
+    printf("INFO: %d NUMA nodes, %d runs per point, max RSS %zu MB\n",
+           num_nodes, runs, max_rss / MB);
+
+    // Probe for Mitosis support
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        if (errno != EINVAL) {
+            printf("FAIL: PR_SET_PGTABLE_REPL probe failed: %s\n", strerror(errno));
+            return 1;
+        }
+        printf("INFO: PR_SET_PGTABLE_REPL returned EINVAL, stock kernel baseline mode\n");
+        baseline = 1;
+    } else {
+        prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+    }
+
+    // arg2=1 means all online nodes; wider explicit masks cover 2..N nodes
+    masks[num_masks++] = 1;
+    for (int w = 2; w <= num_nodes && num_masks < MAX_MASKS; w++) {
+        unsigned long mask = mt_node_mask(w);
+        if (mask) {
+            masks[num_masks++] = mask;
+        }
+    }
+    if (baseline) {
+        num_masks = 1;
+    }
+
+    uint64_t *enable_ns = calloc(runs, sizeof(uint64_t));
+    uint64_t *disable_ns = calloc(runs, sizeof(uint64_t));
+    if (!enable_ns || !disable_ns) {
+        printf("FAIL: Could not allocate sample buffers\n");
+        return 1;
+    }
+
+    for (size_t b = 0; b < NUM_BUCKETS; b++) {
+        size_t size = rss_buckets[b];
+        if (size > max_rss) {
+            break;
+        }
+        if (size > mt_available_memory() / 4 * 3) {
+            printf("\nNOTE: RSS %zu MB exceeds available memory, skipped\n", size / MB);
+            continue;
+        }
+
+        char *mem = populate(size);
+        if (!mem) {
+            printf("\nNOTE: mmap of %zu MB failed, skipped: %s\n", size / MB, strerror(errno));
+            continue;
+        }
+
+        for (int m = 0; m < num_masks; m++) {
+            long width = 0;
+            int failed = 0;
+
+            for (int r = 0; r < runs; r++) {
+                uint64_t t0 = mt_now_ns();
+                long ret = prctl(PR_SET_PGTABLE_REPL, masks[m], 0, 0, 0);
+                uint64_t t1 = mt_now_ns();
+
+                if (ret < 0 && !baseline) {
+                    printf("FAIL: Enable mask=0x%lx failed: %s\n",
+                           masks[m], strerror(errno));
+                    failed = 1;
+                    break;
+                }
+                if (!baseline) {
+                    width = __builtin_popcountl(prctl(PR_GET_PGTABLE_REPL, 0, 0, 0, 0));
+                }
+
+                uint64_t t2 = mt_now_ns();
+                prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+                uint64_t t3 = mt_now_ns();
+
+                enable_ns[r] = t1 - t0;
+                disable_ns[r] = t3 - t2;
+            }
+
+            if (failed) {
+                continue;
+            }
+
+            char point[64], name[96];
+            snprintf(point, sizeof(point), "rss%zumb_mask0x%lx%s", size / MB,
+                     masks[m], baseline ? "_baseline" : "");
+
+            printf("\nRSS %6zu MB  mask=0x%-4lx width=%ld%s\n", size / MB,
+                   masks[m], width, baseline ? " (baseline)" : "");
+            snprintf(name, sizeof(name), "%s_enable", point);
+            mt_report_latency(name, "enable", enable_ns, runs);
+            snprintf(name, sizeof(name), "%s_disable", point);
+            mt_report_latency(name, "disable", disable_ns, runs);
+        }
+
+        munmap(mem, size);
+    }
+
+    free(enable_ns);
+    free(disable_ns);
+
+    printf("\nBench1: DONE\n");
+    return mt_done();
+}
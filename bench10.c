@@ -0,0 +1,250 @@
+// bench10.c - First-touch page-fault scaling across nodes
+// Threads pinned one per CPU (CPUs taken round-robin across nodes) fault
+// disjoint slices of one shared anonymous mapping, 4KB pages, from 1 thread
+// up to every online CPU. Reports aggregate and per-node faults/sec with
+// replication off and on, to show whether replicated PTE installs serialize
+// on page-table locks at high core counts.
+//
+// Usage: ./bench10 [mb_per_thread] [max_threads]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define MB (1024UL * 1024UL)
+#define DEFAULT_PER_THREAD (64 * MB)
+#define MAX_THREADS 1024
+#define MAX_NODES 64
+
+typedef struct {
+    int cpu;
+    int node;
+    char *start;
+    size_t size;
+    uint64_t start_ns;
+    uint64_t end_ns;
+} worker_t;
+
+typedef struct {
+    double aggregate;
+    double per_node[MAX_NODES];
+} result_t;
+
+static pthread_barrier_t start_barrier;
+static int cpu_order[MAX_THREADS];
+static int cpu_node[MAX_THREADS];
+
+static void *touch_thread(void *arg) {
+    worker_t *w = (worker_t *)arg;
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset);
+    CPU_SET(w->cpu, &cpuset);
+    sched_setaffinity(0, sizeof(cpuset), &cpuset);
+    pthread_barrier_wait(&start_barrier);
+
+    w->start_ns = mt_now_ns();
+    for (size_t off = 0; off < w->size; off += PAGE_SIZE) {
+        w->start[off] = 1;
+    }
+    w->end_ns = mt_now_ns();
+    return NULL;
+}
+
+// Online CPUs ordered so that consecutive threads land on different nodes
+static int build_cpu_order(int num_nodes) {
+    int count = 0;
+    int remaining = 1;
+    struct bitmask *cpus = numa_allocate_cpumask();
+    int *next = calloc(num_nodes, sizeof(int));
+
+    while (remaining && count < MAX_THREADS) {
+        remaining = 0;
+        for (int n = 0; n < num_nodes && count < MAX_THREADS; n++) {
+            if (numa_node_to_cpus(n, cpus) < 0) {
+                continue;
+            }
+            for (int cpu = next[n]; cpu < numa_num_configured_cpus(); cpu++) {
+                if (numa_bitmask_isbitset(cpus, cpu)) {
+                    cpu_order[count] = cpu;
+                    cpu_node[count] = n;
+                    count++;
+                    next[n] = cpu + 1;
+                    remaining = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    free(next);
+    numa_free_cpumask(cpus);
+    return count;
+}
+
+static int run_point(int nthreads, int num_nodes, size_t per_thread, result_t *r) {
+    pthread_t threads[MAX_THREADS];
+    static worker_t workers[MAX_THREADS];
+    uint64_t first_start = UINT64_MAX, last_end = 0;
+    size_t size = per_thread * nthreads;
+
+    char *heap = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (heap == MAP_FAILED) {
+        return -1;
+    }
+    madvise(heap, size, MADV_NOHUGEPAGE);
+
+    pthread_barrier_init(&start_barrier, NULL, nthreads);
+    for (int t = 0; t < nthreads; t++) {
+        workers[t].cpu = cpu_order[t];
+        workers[t].node = cpu_node[t];
+        workers[t].start = heap + t * per_thread;
+        workers[t].size = per_thread;
+        if (pthread_create(&threads[t], NULL, touch_thread, &workers[t]) != 0) {
+            printf("FAIL: Cannot create thread %d\n", t);
+            exit(1);
+        }
+    }
+
+    memset(r, 0, sizeof(*r));
+    for (int t = 0; t < nthreads; t++) {
+        pthread_join(threads[t], NULL);
+        if (workers[t].start_ns < first_start) {
+            first_start = workers[t].start_ns;
+        }
+        if (workers[t].end_ns > last_end) {
+            last_end = workers[t].end_ns;
+        }
+        if (workers[t].node < num_nodes && workers[t].end_ns > workers[t].start_ns) {
+            r->per_node[workers[t].node] += (per_thread / PAGE_SIZE) /
+                ((workers[t].end_ns - workers[t].start_ns) / 1e9);
+        }
+    }
+    pthread_barrier_destroy(&start_barrier);
+    munmap(heap, size);
+
+    r->aggregate = (size / PAGE_SIZE) / ((last_end - first_start) / 1e9);
+    return 0;
+}
+
+static void emit(const char *mode, int nthreads, int num_nodes, const result_t *r) {
+    char name[96];
+
+    snprintf(name, sizeof(name), "%s_t%d_faults", mode, nthreads);
+    mt_metric(name, r->aggregate, "faults/s");
+    for (int n = 0; n < num_nodes; n++) {
+        if (r->per_node[n] > 0) {
+            snprintf(name, sizeof(name), "%s_t%d_node%d_faults", mode, nthreads, n);
+            mt_metric(name, r->per_node[n], "faults/s");
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t per_thread = DEFAULT_PER_THREAD;
+    int max_threads = MAX_THREADS;
+    int num_nodes = 1;
+    int repl_supported = 1;
+
+    if (argc > 1) {
+        per_thread = strtoul(argv[1], NULL, 0) * MB;
+    }
+    if (argc > 2) {
+        max_threads = atoi(argv[2]);
+    }
+
+    mt_init("bench10");
+    printf("Bench10: First-Touch Page-Fault Scaling Across Nodes\n");
+    printf("====================================================\n");
+
+    if (numa_available() < 0) {
+        printf("SKIP: NUMA not available\n");
+        return 0;
+    }
+    num_nodes = numa_num_configured_nodes();
+    if (num_nodes > MAX_NODES) {
+        num_nodes = MAX_NODES;
+    }
+
+    int num_cpus = build_cpu_order(num_nodes);
+    if (max_threads > num_cpus) {
+        max_threads = num_cpus;
+    }
+    if (max_threads < 1 || per_thread < PAGE_SIZE) {
+        printf("FAIL: No usable CPUs or per-thread size too small\n");
+        return 1;
+    }
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), replication-off only\n", strerror(errno));
+        repl_supported = 0;
+    }
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+    printf("INFO: %d NUMA nodes, %d CPUs, %zu MB per thread, up to %d threads\n",
+           num_nodes, num_cpus, per_thread / MB, max_threads);
+    printf("\n%7s | %14s | %14s | %6s\n", "threads", "off faults/s", "on faults/s", "on/off");
+
+    // Powers of two, always ending with every CPU
+    for (int nthreads = 1; ; ) {
+        result_t off, on;
+
+        if (per_thread * nthreads > mt_available_memory() / 2) {
+            printf("%7d | NOTE: exceeds available memory, skipped\n", nthreads);
+            break;
+        }
+
+        if (run_point(nthreads, num_nodes, per_thread, &off) < 0) {
+            printf("FAIL: mmap failed at %d threads: %s\n", nthreads, strerror(errno));
+            return 1;
+        }
+        emit("off", nthreads, num_nodes, &off);
+
+        if (repl_supported) {
+            prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+            int ret = run_point(nthreads, num_nodes, per_thread, &on);
+            prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+            if (ret < 0) {
+                printf("FAIL: mmap failed with replication: %s\n", strerror(errno));
+                return 1;
+            }
+            emit("on", nthreads, num_nodes, &on);
+            printf("%7d | %14.0f | %14.0f | %6.2f\n", nthreads, off.aggregate,
+                   on.aggregate, on.aggregate / off.aggregate);
+        } else {
+            printf("%7d | %14.0f | %14s | %6s\n", nthreads, off.aggregate, "-", "-");
+        }
+
+        for (int n = 0; n < num_nodes; n++) {
+            if (off.per_node[n] == 0) {
+                continue;
+            }
+            printf("node%3d | %14.0f |", n, off.per_node[n]);
+            if (repl_supported) {
+                printf(" %14.0f |\n", on.per_node[n]);
+            } else {
+                printf(" %14s |\n", "-");
+            }
+        }
+
+        if (nthreads == max_threads) {
+            break;
+        }
+        nthreads = nthreads * 2 < max_threads ? nthreads * 2 : max_threads;
+    }
+
+    printf("\nBench10: DONE\n");
+    return mt_done();
+}
@@ -0,0 +1,245 @@
+// bench11.c - Thread creation/teardown cost in a replicated mm
+// Thread-per-request style churn. New threads are created directly on nodes
+// round-robin (affinity set in the attr) and each stamps when it first runs,
+// then reads one byte per page of a shared working set whose replica on that
+// node was populated by an earlier thread. Reports create-to-running,
+// create-to-joined, the first working-set sweep, and batched churn rate with
+// replication off and on.
+//
+// Usage: ./bench11 [runs] [working_set_mb]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define MB (1024UL * 1024UL)
+#define DEFAULT_RUNS 1000
+#define DEFAULT_WORKING_SET (16 * MB)
+#define CHURN_BATCH 64
+#define CHURN_THREADS 4096
+#define MAX_NODES 64
+
+enum { LAT_RUNNING, LAT_JOINED, LAT_SWEEP, NUM_LAT };
+static const char *lat_names[NUM_LAT] = { "running", "joined", "sweep" };
+
+typedef struct {
+    uint64_t running_ns;
+    uint64_t sweep_ns;
+} spawn_t;
+
+static char *working_set;
+static size_t working_set_size;
+static pthread_attr_t node_attr[MAX_NODES];
+
+static void *spawn_thread(void *arg) {
+    spawn_t *s = (spawn_t *)arg;
+    volatile char sink;
+
+    s->running_ns = mt_now_ns();
+    for (size_t off = 0; off < working_set_size; off += PAGE_SIZE) {
+        sink = working_set[off];
+    }
+    (void)sink;
+    s->sweep_ns = mt_now_ns() - s->running_ns;
+    return NULL;
+}
+
+static void *churn_thread(void *arg) {
+    return arg;
+}
+
+// Thread attrs that start the new thread on a node's CPUs
+static int init_node_attrs(int num_nodes) {
+    struct bitmask *cpus = numa_allocate_cpumask();
+
+    for (int n = 0; n < num_nodes; n++) {
+        cpu_set_t cpuset;
+
+        CPU_ZERO(&cpuset);
+        if (numa_node_to_cpus(n, cpus) < 0) {
+            numa_free_cpumask(cpus);
+            return -1;
+        }
+        for (int cpu = 0; cpu < numa_num_configured_cpus(); cpu++) {
+            if (numa_bitmask_isbitset(cpus, cpu)) {
+                CPU_SET(cpu, &cpuset);
+            }
+        }
+        pthread_attr_init(&node_attr[n]);
+        if (CPU_COUNT(&cpuset) > 0) {
+            pthread_attr_setaffinity_np(&node_attr[n], sizeof(cpuset), &cpuset);
+        }
+    }
+
+    numa_free_cpumask(cpus);
+    return 0;
+}
+
+static int spawn_one(int node, uint64_t lat[NUM_LAT]) {
+    pthread_t thread;
+    spawn_t s = { 0 };
+
+    uint64_t t0 = mt_now_ns();
+    if (pthread_create(&thread, &node_attr[node], spawn_thread, &s) != 0) {
+        return -1;
+    }
+    pthread_join(thread, NULL);
+    uint64_t t1 = mt_now_ns();
+
+    lat[LAT_RUNNING] = s.running_ns - t0;
+    lat[LAT_JOINED] = t1 - t0;
+    lat[LAT_SWEEP] = s.sweep_ns;
+    return 0;
+}
+
+static double churn_rate(int num_nodes) {
+    pthread_t threads[CHURN_BATCH];
+
+    uint64_t t0 = mt_now_ns();
+    for (int done = 0; done < CHURN_THREADS; done += CHURN_BATCH) {
+        int created = 0;
+
+        while (created < CHURN_BATCH &&
+               pthread_create(&threads[created], &node_attr[created % num_nodes],
+                              churn_thread, NULL) == 0) {
+            created++;
+        }
+        // Join whatever started, so a failed batch leaves nothing running
+        for (int i = 0; i < created; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        if (created < CHURN_BATCH) {
+            return -1;
+        }
+    }
+    return CHURN_THREADS / ((mt_now_ns() - t0) / 1e9);
+}
+
+int main(int argc, char **argv) {
+    int runs = DEFAULT_RUNS;
+    int num_nodes = 1;
+    int repl_supported = 1;
+    uint64_t *samples[NUM_LAT];
+
+    working_set_size = DEFAULT_WORKING_SET;
+    if (argc > 1) {
+        runs = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        working_set_size = strtoul(argv[2], NULL, 0) * MB;
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+
+    mt_init("bench11");
+    printf("Bench11: Thread Creation/Teardown Cost in a Replicated mm\n");
+    printf("=========================================================\n");
+
+    if (numa_available() < 0) {
+        printf("SKIP: NUMA not available\n");
+        return 0;
+    }
+    num_nodes = numa_num_configured_nodes();
+    if (num_nodes > MAX_NODES) {
+        num_nodes = MAX_NODES;
+    }
+    if (init_node_attrs(num_nodes) < 0) {
+        printf("FAIL: Cannot read node CPU lists\n");
+        return 1;
+    }
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), replication-off only\n", strerror(errno));
+        repl_supported = 0;
+    }
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+    printf("INFO: %d NUMA nodes, %d spawns per mode, %zu MB working set\n",
+           num_nodes, runs, working_set_size / MB);
+
+    working_set = mmap(NULL, working_set_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    for (int l = 0; l < NUM_LAT; l++) {
+        samples[l] = calloc(runs, sizeof(uint64_t));
+    }
+    if (working_set == MAP_FAILED || !samples[0] || !samples[1] || !samples[2]) {
+        printf("FAIL: Could not allocate working set or sample buffers\n");
+        return 1;
+    }
+    madvise(working_set, working_set_size, MADV_NOHUGEPAGE);
+    memset(working_set, 1, working_set_size);
+
+    double off_churn = 0;
+    for (int mode = 0; mode < 1 + repl_supported; mode++) {
+        const char *label = mode ? "on" : "off";
+        uint64_t lat[NUM_LAT];
+        char name[96];
+
+        if (mode) {
+            prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+        }
+
+        // One untimed spawn per node populates that node's replica
+        for (int n = 0; n < num_nodes; n++) {
+            if (spawn_one(n, lat) < 0) {
+                printf("FAIL: Cannot create warm-up thread on node %d\n", n);
+                return 1;
+            }
+        }
+
+        for (int r = 0; r < runs; r++) {
+            if (spawn_one(r % num_nodes, lat) < 0) {
+                printf("FAIL: Cannot create thread %d\n", r);
+                return 1;
+            }
+            for (int l = 0; l < NUM_LAT; l++) {
+                samples[l][r] = lat[l];
+            }
+        }
+
+        double churn = churn_rate(num_nodes);
+        prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+        if (churn < 0) {
+            printf("FAIL: Cannot create churn threads\n");
+            return 1;
+        }
+
+        printf("\nReplication %s\n", label);
+        for (int l = 0; l < NUM_LAT; l++) {
+            snprintf(name, sizeof(name), "%s_%s", label, lat_names[l]);
+            mt_report_latency(name, lat_names[l], samples[l], runs);
+        }
+        printf("  churn    %10.0f threads/s (batches of %d)", churn, CHURN_BATCH);
+        if (mode) {
+            printf("  (%.2fx off)", churn / off_churn);
+        } else {
+            off_churn = churn;
+        }
+        printf("\n");
+        snprintf(name, sizeof(name), "%s_churn", label);
+        mt_metric(name, churn, "threads/s");
+    }
+
+    for (int l = 0; l < NUM_LAT; l++) {
+        free(samples[l]);
+    }
+    for (int n = 0; n < num_nodes; n++) {
+        pthread_attr_destroy(&node_attr[n]);
+    }
+    munmap(working_set, working_set_size);
+
+    printf("\nBench11: DONE\n");
+    return mt_done();
+}
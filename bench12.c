@@ -0,0 +1,275 @@
+// bench12.c - Futex ping-pong round trip between replicated tasks
+// With per-node page-table roots, switching between tasks on different nodes
+// may load different roots. Two tasks bounce a futex word in a shared page:
+// threads of one mm and separate processes, on the same node and on two
+// nodes, with replication off and on. Reports the median round trip in ns
+// over several runs.
+//
+// Usage: ./bench12 [round_trips] [runs]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define DEFAULT_ROUND_TRIPS 100000
+#define DEFAULT_RUNS 5
+#define WARMUP_ROUND_TRIPS 1000
+
+typedef struct {
+    const char *name;
+    int cross_process;
+    int cross_node;
+} pair_t;
+
+static const pair_t pairs[] = {
+    { "thread_same", 0, 0 },
+    { "thread_cross", 0, 1 },
+    { "process_same", 1, 0 },
+    { "process_cross", 1, 1 },
+};
+#define NUM_PAIRS (sizeof(pairs) / sizeof(pairs[0]))
+
+typedef struct {
+    int *word;
+    int cpu;
+    int round_trips;
+    uint64_t ns;
+} side_t;
+
+static long futex(int *uaddr, int op, int val) {
+    return syscall(SYS_futex, uaddr, op, val, NULL, NULL, 0);
+}
+
+static void pin_to_cpu(int cpu) {
+    cpu_set_t cpuset;
+
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    sched_setaffinity(0, sizeof(cpuset), &cpuset);
+}
+
+// Returns the index-th CPU of a node, or -1
+static int node_cpu(int node, int index) {
+    struct bitmask *cpus = numa_allocate_cpumask();
+    int found = -1;
+
+    if (numa_node_to_cpus(node, cpus) == 0) {
+        for (int cpu = 0; cpu < numa_num_configured_cpus(); cpu++) {
+            if (numa_bitmask_isbitset(cpus, cpu) && index-- == 0) {
+                found = cpu;
+                break;
+            }
+        }
+    }
+    numa_free_cpumask(cpus);
+    return found;
+}
+
+// Shared futexes (no FUTEX_PRIVATE_FLAG) so the same code works across processes
+static void ping(int *word, int n) {
+    for (int i = 0; i < n; i++) {
+        __atomic_store_n(word, 1, __ATOMIC_RELEASE);
+        futex(word, FUTEX_WAKE, 1);
+        while (__atomic_load_n(word, __ATOMIC_ACQUIRE) == 1) {
+            futex(word, FUTEX_WAIT, 1);
+        }
+    }
+}
+
+static void pong(int *word, int n) {
+    for (int i = 0; i < n; i++) {
+        while (__atomic_load_n(word, __ATOMIC_ACQUIRE) == 0) {
+            futex(word, FUTEX_WAIT, 0);
+        }
+        __atomic_store_n(word, 0, __ATOMIC_RELEASE);
+        futex(word, FUTEX_WAKE, 1);
+    }
+}
+
+static void *ping_thread(void *arg) {
+    side_t *s = (side_t *)arg;
+
+    pin_to_cpu(s->cpu);
+    ping(s->word, WARMUP_ROUND_TRIPS);
+    uint64_t t0 = mt_now_ns();
+    ping(s->word, s->round_trips);
+    s->ns = mt_now_ns() - t0;
+    return NULL;
+}
+
+static void *pong_thread(void *arg) {
+    side_t *s = (side_t *)arg;
+
+    pin_to_cpu(s->cpu);
+    pong(s->word, WARMUP_ROUND_TRIPS + s->round_trips);
+    return NULL;
+}
+
+// Returns ns per round trip, or -1
+static double run_pair(int *word, const pair_t *p, int cpu_a, int cpu_b,
+                       int round_trips, int repl) {
+    side_t a = { word, cpu_a, round_trips, 0 };
+    side_t b = { word, cpu_b, round_trips, 0 };
+    pthread_t ta, tb;
+    pid_t pid = -1;
+    int status, ret;
+
+    *word = 0;
+    if (p->cross_process) {
+        pid = fork();
+        if (pid < 0) {
+            return -1;
+        }
+        if (pid == 0) {
+            // Replication is not inherited; the child opts in on its own
+            if (repl) {
+                prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+            }
+            pong_thread(&b);
+            _exit(0);
+        }
+    } else if ((ret = pthread_create(&tb, NULL, pong_thread, &b)) != 0) {
+        errno = ret;
+        return -1;
+    }
+
+    if ((ret = pthread_create(&ta, NULL, ping_thread, &a)) != 0) {
+        // The pong side would wait forever: kill the child, or finish the
+        // exchange from here so the thread can be joined
+        if (p->cross_process) {
+            kill(pid, SIGKILL);
+            waitpid(pid, &status, 0);
+        } else {
+            ping(word, WARMUP_ROUND_TRIPS + round_trips);
+            pthread_join(tb, NULL);
+        }
+        errno = ret;
+        return -1;
+    }
+    pthread_join(ta, NULL);
+
+    if (p->cross_process) {
+        waitpid(pid, &status, 0);
+    } else {
+        pthread_join(tb, NULL);
+    }
+    return (double)a.ns / round_trips;
+}
+
+int main(int argc, char **argv) {
+    int round_trips = DEFAULT_ROUND_TRIPS;
+    int runs = DEFAULT_RUNS;
+    int num_nodes = 1;
+    int repl_supported = 1;
+
+    if (argc > 1) {
+        round_trips = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        runs = atoi(argv[2]);
+    }
+    if (round_trips < 1) {
+        round_trips = 1;
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+
+    mt_init("bench12");
+    printf("Bench12: Futex Ping-Pong Between Replicated Tasks\n");
+    printf("=================================================\n");
+
+    if (numa_available() < 0) {
+        printf("SKIP: NUMA not available\n");
+        return 0;
+    }
+    num_nodes = numa_num_configured_nodes();
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), replication-off only\n", strerror(errno));
+        repl_supported = 0;
+    }
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+    int *word = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    uint64_t *samples = calloc(runs, sizeof(uint64_t));
+    if (word == MAP_FAILED || !samples) {
+        printf("FAIL: Could not allocate futex page or sample buffer\n");
+        return 1;
+    }
+
+    printf("INFO: %d NUMA nodes, %d round trips x %d runs per point\n",
+           num_nodes, round_trips, runs);
+    printf("\n%-14s %5s %5s | %10s | %10s | %6s\n", "pair", "cpu_a", "cpu_b",
+           "off ns", "on ns", "on/off");
+
+    for (size_t p = 0; p < NUM_PAIRS; p++) {
+        int cpu_a = node_cpu(0, 0);
+        int cpu_b = pairs[p].cross_node ? node_cpu(1, 0) : node_cpu(0, 1);
+        double median[2] = { 0, 0 };
+
+        if (pairs[p].cross_node && (num_nodes < 2 || cpu_b < 0)) {
+            printf("%-14s NOTE: needs 2 NUMA nodes with CPUs, skipped\n", pairs[p].name);
+            continue;
+        }
+        if (cpu_b < 0) {
+            // Single-CPU node: both tasks share the CPU
+            cpu_b = cpu_a;
+        }
+        if (cpu_a < 0) {
+            printf("%-14s NOTE: no CPU on node 0, skipped\n", pairs[p].name);
+            continue;
+        }
+
+        for (int mode = 0; mode < 1 + repl_supported; mode++) {
+            char name[96];
+
+            if (mode) {
+                prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+            }
+            for (int r = 0; r < runs; r++) {
+                double rt = run_pair(word, &pairs[p], cpu_a, cpu_b, round_trips, mode);
+                if (rt < 0) {
+                    printf("FAIL: Cannot start %s pair: %s\n", pairs[p].name, strerror(errno));
+                    return 1;
+                }
+                samples[r] = (uint64_t)rt;
+            }
+            prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+            qsort(samples, runs, sizeof(uint64_t), mt_cmp_u64);
+            median[mode] = samples[(runs - 1) / 2];
+            snprintf(name, sizeof(name), "%s_%s_rt", mode ? "on" : "off", pairs[p].name);
+            mt_metric(name, median[mode], "ns");
+        }
+
+        printf("%-14s %5d %5d | %10.0f |", pairs[p].name, cpu_a, cpu_b, median[0]);
+        if (repl_supported) {
+            printf(" %10.0f | %6.2f\n", median[1], median[1] / median[0]);
+        } else {
+            printf(" %10s | %6s\n", "-", "-");
+        }
+    }
+
+    free(samples);
+    munmap(word, PAGE_SIZE);
+
+    printf("\nBench12: DONE\n");
+    return mt_done();
+}
@@ -0,0 +1,204 @@
+// bench13.c - Thread migration penalty: walk cost right after migrating
+// Benchmark version of migration_thread() in test35. A thread bounces
+// across nodes with sched_setaffinity and, immediately after each move,
+// pointer-chases a page-strided working set so nearly every access misses
+// the TLB. Per-access latency is bucketed by distance from the migration and
+// averaged over all migrations, with replication off and on, to show how
+// quickly a migrated thread gets local walks.
+//
+// Usage: ./bench13 [working_set_mb] [migrations]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define MB (1024UL * 1024UL)
+#define DEFAULT_WORKING_SET (1024 * MB)
+#define MIGRATION_CYCLES 100
+#define CHUNK_ACCESSES 256
+#define NUM_CHUNKS 64   // 16K accesses timed after each migration
+
+// Buckets of chunks reported: [first, last)
+static const struct {
+    int first;
+    int last;
+    const char *name;
+} buckets[] = {
+    { 0, 1, "0-256" },
+    { 1, 4, "256-1K" },
+    { 4, 16, "1K-4K" },
+    { 16, NUM_CHUNKS, "4K-16K" },
+};
+#define NUM_BUCKETS (sizeof(buckets) / sizeof(buckets[0]))
+
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint64_t xorshift64(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Sattolo's algorithm: a single cycle through every page; -1 if the
+// permutation cannot be allocated
+static int build_chain(char *mem, size_t pages) {
+    size_t *order = malloc(pages * sizeof(size_t));
+
+    if (!order) {
+        return -1;
+    }
+    for (size_t i = 0; i < pages; i++) {
+        order[i] = i;
+    }
+    for (size_t i = pages - 1; i > 0; i--) {
+        size_t j = xorshift64() % i;
+        size_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    for (size_t i = 0; i < pages; i++) {
+        *(size_t *)(mem + order[i] * PAGE_SIZE) = order[(i + 1) % pages];
+    }
+    free(order);
+    return 0;
+}
+
+// Migrates every cycle and accumulates ns per access per chunk
+static void run_migrations(char *mem, int num_nodes, int cycles, double chunk_ns[NUM_CHUNKS]) {
+    size_t idx = 0;
+
+    memset(chunk_ns, 0, NUM_CHUNKS * sizeof(double));
+    for (int cycle = 0; cycle < cycles; cycle++) {
+        pin_to_node((cycle + 1) % num_nodes);
+
+        for (int c = 0; c < NUM_CHUNKS; c++) {
+            uint64_t t0 = mt_now_ns();
+            for (int a = 0; a < CHUNK_ACCESSES; a++) {
+                idx = *(volatile size_t *)(mem + idx * PAGE_SIZE);
+            }
+            chunk_ns[c] += (double)(mt_now_ns() - t0) / CHUNK_ACCESSES;
+        }
+        usleep(1000);
+    }
+    for (int c = 0; c < NUM_CHUNKS; c++) {
+        chunk_ns[c] /= cycles;
+    }
+}
+
+static double bucket_ns(const double chunk_ns[NUM_CHUNKS], size_t b) {
+    double sum = 0;
+
+    for (int c = buckets[b].first; c < buckets[b].last; c++) {
+        sum += chunk_ns[c];
+    }
+    return sum / (buckets[b].last - buckets[b].first);
+}
+
+int main(int argc, char **argv) {
+    size_t size = DEFAULT_WORKING_SET;
+    int cycles = MIGRATION_CYCLES;
+    int num_nodes;
+    int repl_supported = 1;
+    double chunk_ns[2][NUM_CHUNKS];
+
+    if (argc > 1) {
+        size = strtoul(argv[1], NULL, 0) * MB;
+    }
+    if (argc > 2) {
+        cycles = atoi(argv[2]);
+    }
+    if (cycles < 1) {
+        cycles = 1;
+    }
+
+    mt_init("bench13");
+    printf("Bench13: Thread Migration Penalty (Post-Migration Walk Cost)\n");
+    printf("============================================================\n");
+
+    if (numa_available() < 0) {
+        printf("SKIP: NUMA not available\n");
+        return 0;
+    }
+    num_nodes = numa_num_configured_nodes();
+    if (num_nodes < 2) {
+        printf("NOTE: Single node, migrations stay on node 0\n");
+    }
+
+    if (size > mt_available_memory() / 2) {
+        size = mt_available_memory() / 2 / MB * MB;
+        printf("NOTE: Working set clamped to %zu MB by available memory\n", size / MB);
+    }
+    size_t pages = size / PAGE_SIZE;
+    if (pages < 2) {
+        printf("FAIL: Working set too small\n");
+        return 1;
+    }
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), replication-off only\n", strerror(errno));
+        repl_supported = 0;
+    }
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+    printf("INFO: %d NUMA nodes, %zu MB working set, %d migrations, %d accesses timed each\n",
+           num_nodes, size / MB, cycles, NUM_CHUNKS * CHUNK_ACCESSES);
+
+    // Populated from node 0 so the unreplicated page tables live there
+    pin_to_node(0);
+    char *mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem == MAP_FAILED) {
+        printf("FAIL: mmap of %zu MB failed: %s\n", size / MB, strerror(errno));
+        return 1;
+    }
+    madvise(mem, size, MADV_NOHUGEPAGE);
+    if (build_chain(mem, pages) < 0) {
+        printf("FAIL: Cannot allocate the %zu-page chain order: %s\n", pages, strerror(errno));
+        munmap(mem, size);
+        return 1;
+    }
+
+    for (int mode = 0; mode < 1 + repl_supported; mode++) {
+        if (mode) {
+            prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+        }
+        pin_to_node(0);
+        run_migrations(mem, num_nodes, cycles, chunk_ns[mode]);
+        prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+    }
+
+    printf("\n%-20s | %10s | %10s | %6s\n", "accesses after move", "off ns", "on ns", "on/off");
+    for (size_t b = 0; b < NUM_BUCKETS; b++) {
+        double off = bucket_ns(chunk_ns[0], b);
+        char name[64];
+
+        snprintf(name, sizeof(name), "off_%s", buckets[b].name);
+        mt_metric(name, off, "ns/access");
+        printf("%-20s | %10.1f |", buckets[b].name, off);
+
+        if (repl_supported) {
+            double on = bucket_ns(chunk_ns[1], b);
+            snprintf(name, sizeof(name), "on_%s", buckets[b].name);
+            mt_metric(name, on, "ns/access");
+            printf(" %10.1f | %6.2f\n", on, on / off);
+        } else {
+            printf(" %10s | %6s\n", "-", "-");
+        }
+    }
+
+    munmap(mem, size);
+
+    printf("\nBench13: DONE\n");
+    return mt_done();
+}
@@ -0,0 +1,247 @@
+// bench14.c - mprotect throughput over replicated regions
+// JIT/GC-style protection flips: threads placed round-robin across nodes
+// each own a populated 4KB-page region (4KB to 1GB) and flip it between
+// read-only and read-write in a loop, so every flip rewrites the PTEs of
+// every replica. Reports ns per page per flip and TLB flushes per flip
+// (shootdown IPIs from /proc/interrupts, remote flushes from /proc/vmstat
+// when the kernel exports them) with replication off and on.
+//
+// Usage: ./bench14 [max_threads] [bytes_per_thread_mb]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define KB 1024UL
+#define MB (1024UL * KB)
+#define GB (1024UL * MB)
+#define DEFAULT_BYTES_PER_THREAD (1 * GB)
+#define MIN_ITERATIONS 4
+#define MAX_THREADS 256
+
+static const size_t region_sizes[] = {
+    4 * KB, 64 * KB, 1 * MB, 16 * MB, 256 * MB, 1 * GB
+};
+#define NUM_SIZES (sizeof(region_sizes) / sizeof(region_sizes[0]))
+
+typedef struct {
+    int node;
+    size_t size;
+    int iterations;
+    uint64_t mprotect_ns;
+    int failed;
+} worker_t;
+
+typedef struct {
+    double ns_per_page;
+    double ipis;
+    double remote_flushes;
+} result_t;
+
+static pthread_barrier_t start_barrier;
+
+static void *flip_thread(void *arg) {
+    worker_t *w = (worker_t *)arg;
+
+    pin_to_node(w->node);
+    char *mem = mmap(NULL, w->size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        w->failed = 1;
+    } else {
+        madvise(mem, w->size, MADV_NOHUGEPAGE);
+        for (size_t off = 0; off < w->size; off += PAGE_SIZE) {
+            mem[off] = 1;
+        }
+    }
+    pthread_barrier_wait(&start_barrier);
+    if (w->failed) {
+        return NULL;
+    }
+
+    for (int i = 0; i < w->iterations; i++) {
+        uint64_t t0 = mt_now_ns();
+        if (mprotect(mem, w->size, PROT_READ) < 0 ||
+            mprotect(mem, w->size, PROT_READ | PROT_WRITE) < 0) {
+            w->failed = 1;
+            break;
+        }
+        w->mprotect_ns += mt_now_ns() - t0;
+    }
+
+    munmap(mem, w->size);
+    return NULL;
+}
+
+static int run_point(size_t size, int nthreads, int num_nodes,
+                     size_t bytes_per_thread, result_t *r) {
+    pthread_t threads[MAX_THREADS];
+    worker_t workers[MAX_THREADS];
+    int iterations = bytes_per_thread / size;
+    uint64_t mprotect_total = 0;
+    int failed = 0;
+
+    if (iterations < MIN_ITERATIONS) {
+        iterations = MIN_ITERATIONS;
+    }
+
+    pthread_barrier_init(&start_barrier, NULL, nthreads + 1);
+    for (int t = 0; t < nthreads; t++) {
+        memset(&workers[t], 0, sizeof(worker_t));
+        workers[t].node = t % num_nodes;
+        workers[t].size = size;
+        workers[t].iterations = iterations;
+        if (pthread_create(&threads[t], NULL, flip_thread, &workers[t]) != 0) {
+            printf("FAIL: Cannot create thread %d\n", t);
+            exit(1);
+        }
+    }
+
+    // Counters bracket the flips only; population happens before the barrier
+    long long ipi_before = mt_tlb_shootdowns();
+    long long flush_before = mt_vmstat("nr_tlb_remote_flush");
+    pthread_barrier_wait(&start_barrier);
+
+    for (int t = 0; t < nthreads; t++) {
+        pthread_join(threads[t], NULL);
+        failed |= workers[t].failed;
+        mprotect_total += workers[t].mprotect_ns;
+    }
+    long long ipi_after = mt_tlb_shootdowns();
+    long long flush_after = mt_vmstat("nr_tlb_remote_flush");
+    pthread_barrier_destroy(&start_barrier);
+
+    if (failed) {
+        return -1;
+    }
+
+    double flips = 2.0 * iterations * nthreads;
+    r->ns_per_page = mprotect_total / (flips * (size / PAGE_SIZE));
+    r->ipis = ipi_before < 0 ? -1 : (ipi_after - ipi_before) / flips;
+    r->remote_flushes = flush_before < 0 ? -1 : (flush_after - flush_before) / flips;
+    return 0;
+}
+
+static void emit(const char *mode, size_t size, int nthreads, const result_t *r) {
+    char name[96];
+
+    snprintf(name, sizeof(name), "%s_%zukb_t%d_ns_per_page", mode, size / KB, nthreads);
+    mt_metric(name, r->ns_per_page, "ns");
+    if (r->ipis >= 0) {
+        snprintf(name, sizeof(name), "%s_%zukb_t%d_shootdowns", mode, size / KB, nthreads);
+        mt_metric(name, r->ipis, "ipis/flip");
+    }
+    if (r->remote_flushes >= 0) {
+        snprintf(name, sizeof(name), "%s_%zukb_t%d_remote_flushes", mode, size / KB, nthreads);
+        mt_metric(name, r->remote_flushes, "flushes/flip");
+    }
+}
+
+static void print_result(const result_t *r) {
+    printf(" %9.2f", r->ns_per_page);
+    if (r->ipis >= 0) {
+        printf(" %8.2f", r->ipis);
+    } else {
+        printf(" %8s", "n/a");
+    }
+    if (r->remote_flushes >= 0) {
+        printf(" %8.2f |", r->remote_flushes);
+    } else {
+        printf(" %8s |", "n/a");
+    }
+}
+
+int main(int argc, char **argv) {
+    int max_threads;
+    size_t bytes_per_thread = DEFAULT_BYTES_PER_THREAD;
+    int num_nodes = 1;
+    int repl_supported = 1;
+
+    mt_init("bench14");
+    printf("Bench14: mprotect Throughput over Replicated Regions\n");
+    printf("====================================================\n");
+
+    if (numa_available() >= 0) {
+        num_nodes = numa_num_configured_nodes();
+    }
+    max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 1) {
+        max_threads = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        bytes_per_thread = strtoul(argv[2], NULL, 0) * MB;
+    }
+    if (max_threads < 1) {
+        max_threads = 1;
+    }
+    if (max_threads > MAX_THREADS) {
+        max_threads = MAX_THREADS;
+    }
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), replication-off only\n", strerror(errno));
+        repl_supported = 0;
+    }
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+    printf("INFO: %d NUMA nodes, up to %d threads, %zu MB flipped per thread per point\n",
+           num_nodes, max_threads, bytes_per_thread / MB);
+    printf("\n%10s %7s | %9s %8s %8s | %9s %8s %8s | %6s\n", "size", "threads",
+           "off ns/pg", "ipi/flip", "rflush", "on ns/pg", "ipi/flip", "rflush", "on/off");
+
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        size_t size = region_sizes[s];
+
+        // Powers of two, always ending with every CPU
+        for (int nthreads = 1; ; ) {
+            result_t off, on;
+
+            if (size * nthreads > mt_available_memory() / 2) {
+                printf("%8zuKB %7d | NOTE: exceeds available memory, skipped\n",
+                       size / KB, nthreads);
+                break;
+            }
+
+            if (run_point(size, nthreads, num_nodes, bytes_per_thread, &off) < 0) {
+                printf("FAIL: mprotect failed at %zu KB x %d threads\n", size / KB, nthreads);
+                return 1;
+            }
+            emit("off", size, nthreads, &off);
+            printf("%8zuKB %7d |", size / KB, nthreads);
+            print_result(&off);
+
+            if (repl_supported) {
+                prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+                int ret = run_point(size, nthreads, num_nodes, bytes_per_thread, &on);
+                prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+                if (ret < 0) {
+                    printf(" FAIL: mprotect failed with replication\n");
+                    return 1;
+                }
+                emit("on", size, nthreads, &on);
+                print_result(&on);
+                printf(" %6.2f\n", on.ns_per_page / off.ns_per_page);
+            } else {
+                printf(" %9s %8s %8s | %6s\n", "-", "-", "-", "-");
+            }
+
+            if (nthreads == max_threads) {
+                break;
+            }
+            nthreads = nthreads * 2 < max_threads ? nthreads * 2 : max_threads;
+        }
+    }
+
+    printf("\nBench14: DONE\n");
+    return mt_done();
+}
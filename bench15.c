@@ -0,0 +1,199 @@
+// bench15.c - brk/sbrk heap growth and shrink cost under replication
+// Allocator-style heap growth: the program break is pushed up in fixed
+// increments (4KB to 4MB) to a total size, touching every new page, then
+// pulled back down in the same increments. Reports grow syscall, first-touch
+// fault and shrink cost per MB, and the VmPTE growth at peak, with
+// replication off and on. THP is disabled for the process so the heap is
+// always mapped with 4KB PTEs.
+//
+// Usage: ./bench15 [total_mb] [runs]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mitosis_test.h"
+
+#ifndef PR_SET_THP_DISABLE
+#define PR_SET_THP_DISABLE 41
+#endif
+
+#define PAGE_SIZE 4096
+#define KB 1024UL
+#define MB (1024UL * KB)
+#define DEFAULT_TOTAL (256 * MB)
+#define DEFAULT_RUNS 3
+
+static const size_t increments[] = {
+    4 * KB, 16 * KB, 64 * KB, 256 * KB, 1 * MB, 4 * MB
+};
+#define NUM_INCREMENTS (sizeof(increments) / sizeof(increments[0]))
+
+typedef struct {
+    double grow_us_per_mb;
+    double fault_us_per_mb;
+    double shrink_us_per_mb;
+    long pte_kb;
+} result_t;
+
+// One grow/touch/shrink cycle. No printing in here: glibc's heap lives right
+// below the break, and the second VmPTE read reuses the chunk the first freed.
+static int run_once(size_t increment, size_t total, result_t *r) {
+    uint64_t grow_ns = 0, fault_ns = 0, shrink_ns = 0;
+    size_t steps = total / increment;
+    long pte_before = mt_read_kb("/proc/self/status", "VmPTE:");
+
+    for (size_t i = 0; i < steps; i++) {
+        uint64_t t0 = mt_now_ns();
+        char *area = sbrk(increment);
+        uint64_t t1 = mt_now_ns();
+        if (area == (void *)-1) {
+            return -1;
+        }
+        for (size_t off = 0; off < increment; off += PAGE_SIZE) {
+            area[off] = (char)i;
+        }
+        grow_ns += t1 - t0;
+        fault_ns += mt_now_ns() - t1;
+    }
+
+    long pte_peak = mt_read_kb("/proc/self/status", "VmPTE:");
+
+    for (size_t i = 0; i < steps; i++) {
+        uint64_t t0 = mt_now_ns();
+        if (sbrk(-(intptr_t)increment) == (void *)-1) {
+            return -1;
+        }
+        shrink_ns += mt_now_ns() - t0;
+    }
+
+    double mb = (double)steps * increment / MB;
+    r->grow_us_per_mb = grow_ns / 1000.0 / mb;
+    r->fault_us_per_mb = fault_ns / 1000.0 / mb;
+    r->shrink_us_per_mb = shrink_ns / 1000.0 / mb;
+    r->pte_kb = (pte_before < 0 || pte_peak < 0) ? -1 : pte_peak - pte_before;
+    return 0;
+}
+
+// Averages `runs` cycles
+static int run_point(size_t increment, size_t total, int runs, result_t *avg) {
+    memset(avg, 0, sizeof(*avg));
+    for (int i = 0; i < runs; i++) {
+        result_t r;
+        if (run_once(increment, total, &r) < 0) {
+            return -1;
+        }
+        avg->grow_us_per_mb += r.grow_us_per_mb / runs;
+        avg->fault_us_per_mb += r.fault_us_per_mb / runs;
+        avg->shrink_us_per_mb += r.shrink_us_per_mb / runs;
+        avg->pte_kb = r.pte_kb;
+    }
+    return 0;
+}
+
+static void emit(const char *mode, size_t increment, const result_t *r) {
+    char name[96];
+
+    snprintf(name, sizeof(name), "%s_%zukb_grow", mode, increment / KB);
+    mt_metric(name, r->grow_us_per_mb, "us/MB");
+    snprintf(name, sizeof(name), "%s_%zukb_fault", mode, increment / KB);
+    mt_metric(name, r->fault_us_per_mb, "us/MB");
+    snprintf(name, sizeof(name), "%s_%zukb_shrink", mode, increment / KB);
+    mt_metric(name, r->shrink_us_per_mb, "us/MB");
+    if (r->pte_kb >= 0) {
+        snprintf(name, sizeof(name), "%s_%zukb_vmpte", mode, increment / KB);
+        mt_metric(name, r->pte_kb, "kB");
+    }
+}
+
+static void print_result(const result_t *r) {
+    printf(" %8.1f %8.1f %8.1f %7ld |", r->grow_us_per_mb, r->fault_us_per_mb,
+           r->shrink_us_per_mb, r->pte_kb);
+}
+
+int main(int argc, char **argv) {
+    size_t total = DEFAULT_TOTAL;
+    int runs = DEFAULT_RUNS;
+    int num_nodes = 1;
+    int repl_supported = 1;
+
+    if (argc > 1) {
+        total = strtoul(argv[1], NULL, 0) * MB;
+    }
+    if (argc > 2) {
+        runs = atoi(argv[2]);
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+
+    mt_init("bench15");
+    printf("Bench15: brk/sbrk Heap Growth under Replication\n");
+    printf("===============================================\n");
+
+    if (numa_available() >= 0) {
+        num_nodes = numa_num_configured_nodes();
+    }
+    if (total > mt_available_memory() / 2) {
+        total = mt_available_memory() / 2 / MB * MB;
+        printf("NOTE: Total clamped to %zu MB by available memory\n", total / MB);
+    }
+    if (total < increments[NUM_INCREMENTS - 1]) {
+        printf("FAIL: Total heap growth too small\n");
+        return 1;
+    }
+    if (prctl(PR_SET_THP_DISABLE, 1, 0, 0, 0) < 0) {
+        printf("NOTE: PR_SET_THP_DISABLE failed (%s), heap may use THP\n", strerror(errno));
+    }
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), replication-off only\n", strerror(errno));
+        repl_supported = 0;
+    }
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+    printf("INFO: %d NUMA nodes, %zu MB heap growth, %d runs per point\n",
+           num_nodes, total / MB, runs);
+    printf("\n%8s | %8s %8s %8s %7s | %8s %8s %8s %7s |\n", "incr",
+           "grow", "fault", "shrink", "VmPTE", "grow", "fault", "shrink", "VmPTE");
+    printf("%8s | %8s %8s %8s %7s | %8s %8s %8s %7s |\n", "",
+           "us/MB", "us/MB", "us/MB", "kB", "us/MB", "us/MB", "us/MB", "kB");
+    fflush(stdout);
+
+    for (size_t i = 0; i < NUM_INCREMENTS; i++) {
+        size_t increment = increments[i];
+        result_t off, on;
+
+        if (run_point(increment, total, runs, &off) < 0) {
+            printf("FAIL: sbrk(%zu) failed: %s\n", increment, strerror(errno));
+            return 1;
+        }
+        emit("off", increment, &off);
+        printf("%6zuKB |", increment / KB);
+        print_result(&off);
+
+        if (repl_supported) {
+            prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+            int ret = run_point(increment, total, runs, &on);
+            prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+            if (ret < 0) {
+                printf(" FAIL: sbrk failed with replication\n");
+                return 1;
+            }
+            emit("on", increment, &on);
+            print_result(&on);
+        } else {
+            printf(" %8s %8s %8s %7s |", "-", "-", "-", "-");
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    printf("\nBench15: DONE\n");
+    return mt_done();
+}
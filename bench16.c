@@ -0,0 +1,318 @@
+// bench16.c - Stack growth fault cost for deep recursion with replicas
+// Parser-style deep recursion. A fresh child recurses hundreds of MB down
+// the main stack, one page per frame, so every frame takes a fault and
+// extends the grows-down stack VMA. It then recurses again over the
+// now-resident stack. The difference is the stack-expansion fault cost.
+// A second phase does the same on many 8MB pthread stacks spread
+// round-robin across nodes and running concurrently. Results are reported
+// with replication off and on. The program re-executes itself once with a
+// raised RLIMIT_STACK, so the mmap layout leaves room for the stack.
+//
+// Usage: ./bench16 [stack_mb] [threads]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include <math.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define MB (1024UL * 1024UL)
+#define DEFAULT_STACK (256 * MB)
+#define STACK_MARGIN (16 * MB)
+#define THREAD_STACK (8 * MB)
+#define THREAD_DESCENT (6 * MB)
+#define FRAME_SIZE 4000   // a little under a page, so no page is skipped
+#define MAX_THREADS 256
+#define REEXEC_ENV "MITOSIS_BENCH16_REEXEC"
+
+typedef struct {
+    double main_fault_ns;
+    double main_first_ms;
+    double main_resident_ms;
+    double main_mb;
+    double thread_fault_ns;
+    double thread_faults_per_sec;
+    int main_clamped;
+    int thread_clamped;
+    int ok;
+} child_result_t;
+
+typedef struct {
+    int node;
+    int depth;
+    double fault_ns;
+    int clamped;
+    uint64_t first_start_ns;
+    uint64_t first_end_ns;
+    size_t pages;
+} stack_worker_t;
+
+static pthread_barrier_t start_barrier;
+
+// One page-sized frame per level; the frame is used after the call so the
+// compiler cannot turn this into a loop
+__attribute__((noinline))
+static int descend(int depth, char **lowest) {
+    volatile char frame[FRAME_SIZE];
+
+    frame[0] = (char)depth;
+    frame[FRAME_SIZE - 1] = (char)depth;
+    if (depth == 0) {
+        *lowest = (char *)frame;
+        return frame[0];
+    }
+    return descend(depth - 1, lowest) + frame[FRAME_SIZE - 1];
+}
+
+// Per-page cost of the faulting descent over the resident one. Preemption
+// can make the resident pass slower; such samples return NaN, are counted in
+// *clamped and left out of the averages.
+static double fault_cost(uint64_t first_ns, uint64_t resident_ns, size_t pages, int *clamped) {
+    double diff = (double)first_ns - (double)resident_ns;
+
+    if (pages == 0) {
+        return NAN;
+    }
+    if (diff < 0) {
+        (*clamped)++;
+        return NAN;
+    }
+    return diff / pages;
+}
+
+// Times a faulting descent, then a resident one; returns pages touched
+static size_t measure_descent(int depth, uint64_t *first_ns, uint64_t *resident_ns) {
+    char top;
+    char *lowest = &top;
+
+    uint64_t t0 = mt_now_ns();
+    descend(depth, &lowest);
+    uint64_t t1 = mt_now_ns();
+    descend(depth, &lowest);
+    uint64_t t2 = mt_now_ns();
+
+    *first_ns = t1 - t0;
+    *resident_ns = t2 - t1;
+    return (&top - lowest) / PAGE_SIZE;
+}
+
+static void *stack_thread(void *arg) {
+    stack_worker_t *w = (stack_worker_t *)arg;
+    uint64_t first_ns, resident_ns;
+
+    pin_to_node(w->node);
+    pthread_barrier_wait(&start_barrier);
+
+    w->first_start_ns = mt_now_ns();
+    w->pages = measure_descent(w->depth, &first_ns, &resident_ns);
+    w->first_end_ns = w->first_start_ns + first_ns;
+    w->fault_ns = fault_cost(first_ns, resident_ns, w->pages, &w->clamped);
+    return NULL;
+}
+
+// Runs in a fresh child so the main stack starts unexpanded
+static void run_child(int repl, size_t stack_size, int nthreads, int num_nodes,
+                      child_result_t *r) {
+    pthread_t threads[MAX_THREADS];
+    stack_worker_t workers[MAX_THREADS];
+    pthread_attr_t attr;
+    uint64_t first_ns, resident_ns;
+    uint64_t first_start = UINT64_MAX, last_end = 0;
+    double fault_sum = 0;
+    size_t fault_pages = 0;
+    size_t total_pages = 0;
+
+    // Replication is not inherited across fork
+    if (repl && prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        return;
+    }
+
+    // Frames are FRAME_SIZE plus call overhead, so size the depth in whole
+    // pages and keep one spare frame clear of the limit and its guard page
+    size_t pages = measure_descent(stack_size / PAGE_SIZE - 1, &first_ns, &resident_ns);
+    r->main_first_ms = first_ns / 1e6;
+    r->main_resident_ms = resident_ns / 1e6;
+    r->main_mb = (double)pages * PAGE_SIZE / MB;
+    r->main_fault_ns = fault_cost(first_ns, resident_ns, pages, &r->main_clamped);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, THREAD_STACK);
+    pthread_barrier_init(&start_barrier, NULL, nthreads);
+    for (int t = 0; t < nthreads; t++) {
+        memset(&workers[t], 0, sizeof(stack_worker_t));
+        workers[t].node = t % num_nodes;
+        workers[t].depth = THREAD_DESCENT / FRAME_SIZE;
+        if (pthread_create(&threads[t], &attr, stack_thread, &workers[t]) != 0) {
+            return;
+        }
+    }
+    for (int t = 0; t < nthreads; t++) {
+        pthread_join(threads[t], NULL);
+        if (isfinite(workers[t].fault_ns)) {
+            fault_sum += workers[t].fault_ns * workers[t].pages;
+            fault_pages += workers[t].pages;
+        }
+        r->thread_clamped += workers[t].clamped;
+        total_pages += workers[t].pages;
+        if (workers[t].first_start_ns < first_start) {
+            first_start = workers[t].first_start_ns;
+        }
+        if (workers[t].first_end_ns > last_end) {
+            last_end = workers[t].first_end_ns;
+        }
+    }
+    pthread_barrier_destroy(&start_barrier);
+    pthread_attr_destroy(&attr);
+
+    // Page-weighted over the threads whose sample was not clamped
+    r->thread_fault_ns = fault_pages ? fault_sum / fault_pages : NAN;
+    r->thread_faults_per_sec = total_pages / ((last_end - first_start) / 1e9);
+    r->ok = 1;
+}
+
+int main(int argc, char **argv) {
+    size_t stack_size = DEFAULT_STACK;
+    int nthreads;
+    int num_nodes = 1;
+    int repl_supported = 1;
+    struct rlimit rlim;
+    child_result_t results[2];
+
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 1) {
+        stack_size = strtoul(argv[1], NULL, 0) * MB;
+    }
+    if (argc > 2) {
+        nthreads = atoi(argv[2]);
+    }
+    if (nthreads < 1) {
+        nthreads = 1;
+    }
+    if (nthreads > MAX_THREADS) {
+        nthreads = MAX_THREADS;
+    }
+
+    // Raise the limit and re-exec so the kernel lays out mmap_base below it
+    if (getrlimit(RLIMIT_STACK, &rlim) == 0 && rlim.rlim_cur != RLIM_INFINITY &&
+        rlim.rlim_cur < stack_size + STACK_MARGIN && !getenv(REEXEC_ENV)) {
+        rlim.rlim_cur = stack_size + STACK_MARGIN;
+        if (rlim.rlim_max != RLIM_INFINITY && rlim.rlim_cur > rlim.rlim_max) {
+            rlim.rlim_cur = rlim.rlim_max;
+        }
+        if (setrlimit(RLIMIT_STACK, &rlim) == 0) {
+            setenv(REEXEC_ENV, "1", 1);
+            execv("/proc/self/exe", argv);
+        }
+    }
+
+    mt_init("bench16");
+    printf("Bench16: Stack Growth Fault Cost with Replicas\n");
+    printf("==============================================\n");
+
+    if (getrlimit(RLIMIT_STACK, &rlim) == 0 && rlim.rlim_cur != RLIM_INFINITY &&
+        rlim.rlim_cur < stack_size + STACK_MARGIN) {
+        stack_size = rlim.rlim_cur > STACK_MARGIN * 2 ? rlim.rlim_cur - STACK_MARGIN
+                                                      : rlim.rlim_cur / 2;
+        printf("NOTE: RLIMIT_STACK caps the recursion at %zu MB\n", stack_size / MB);
+    }
+
+    if (numa_available() >= 0) {
+        num_nodes = numa_num_configured_nodes();
+    }
+    while (nthreads > 1 && nthreads * THREAD_STACK > mt_available_memory() / 2) {
+        nthreads /= 2;
+    }
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), replication-off only\n", strerror(errno));
+        repl_supported = 0;
+    }
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+    printf("INFO: %d NUMA nodes, %zu MB main-stack recursion, %d threads x %lu MB descent\n",
+           num_nodes, stack_size / MB, nthreads, THREAD_DESCENT / MB);
+
+    child_result_t *shared = mmap(NULL, sizeof(child_result_t), PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        printf("FAIL: Could not allocate result page\n");
+        return 1;
+    }
+
+    for (int mode = 0; mode < 1 + repl_supported; mode++) {
+        int status;
+
+        memset(shared, 0, sizeof(*shared));
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) {
+            printf("FAIL: fork failed: %s\n", strerror(errno));
+            return 1;
+        }
+        if (pid == 0) {
+            run_child(mode, stack_size, nthreads, num_nodes, shared);
+            _exit(0);
+        }
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || !shared->ok) {
+            printf("FAIL: Replication-%s child did not complete (status 0x%x)\n",
+                   mode ? "on" : "off", status);
+            return 1;
+        }
+        results[mode] = *shared;
+        if (results[mode].main_clamped || results[mode].thread_clamped) {
+            printf("NOTE: Replication-%s: %d of 1 main-stack and %d of %d thread samples "
+                   "had a slower resident pass (preempted?), excluded from the averages\n",
+                   mode ? "on" : "off", results[mode].main_clamped,
+                   results[mode].thread_clamped, nthreads);
+        }
+    }
+
+    printf("\nMain stack (grows-down VMA expansion)\n");
+    printf("%-4s | %8s | %12s | %12s | %13s\n", "repl", "MB", "first ms",
+           "resident ms", "fault ns/page");
+    for (int mode = 0; mode < 1 + repl_supported; mode++) {
+        const char *label = mode ? "on" : "off";
+        char name[64];
+
+        printf("%-4s | %8.1f | %12.2f | %12.2f | %13.1f\n", label, results[mode].main_mb,
+               results[mode].main_first_ms, results[mode].main_resident_ms,
+               results[mode].main_fault_ns);
+        snprintf(name, sizeof(name), "%s_main_fault", label);
+        mt_metric(name, results[mode].main_fault_ns, "ns/page");
+        snprintf(name, sizeof(name), "%s_main_clamped", label);
+        mt_metric(name, results[mode].main_clamped, "samples");
+    }
+
+    printf("\nThread stacks (%d threads across %d nodes)\n", nthreads, num_nodes);
+    printf("%-4s | %13s | %14s\n", "repl", "fault ns/page", "faults/s");
+    for (int mode = 0; mode < 1 + repl_supported; mode++) {
+        const char *label = mode ? "on" : "off";
+        char name[64];
+
+        printf("%-4s | %13.1f | %14.0f\n", label, results[mode].thread_fault_ns,
+               results[mode].thread_faults_per_sec);
+        snprintf(name, sizeof(name), "%s_thread_fault", label);
+        mt_metric(name, results[mode].thread_fault_ns, "ns/page");
+        snprintf(name, sizeof(name), "%s_thread_faults", label);
+        mt_metric(name, results[mode].thread_faults_per_sec, "faults/s");
+        snprintf(name, sizeof(name), "%s_thread_clamped", label);
+        mt_metric(name, results[mode].thread_clamped, "samples");
+    }
+
+    munmap(shared, sizeof(child_result_t));
+
+    printf("\nBench16: DONE\n");
+    return mt_done();
+}
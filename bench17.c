@@ -0,0 +1,303 @@
+// bench17.c - THP fault-in, collapse and split cost on replicated PMDs
+// Benchmark counterpart of test22. With replication off and on it measures:
+//   fault-in   MB/s touching a region with MADV_NOHUGEPAGE vs MADV_HUGEPAGE
+//   split      cost of splitting every huge PMD via a 4KB mprotect and via
+//              a 4KB partial munmap
+//   collapse   MADV_COLLAPSE (synchronous khugepaged collapse, Linux 6.1+)
+//              of a 4KB-populated region into huge PMDs
+//   walk       pointer-chase ns/access from the last node over tables built
+//              on node 0, for 4KB vs THP, so THP+replication can be compared
+//              with each alone
+//
+// Usage: ./bench17 [region_mb] [accesses_millions]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mitosis_test.h"
+
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25
+#endif
+
+#define PAGE_SIZE 4096
+#define HPAGE_SIZE (2 * 1024 * 1024)
+#define MB (1024UL * 1024UL)
+#define DEFAULT_REGION (1024 * MB)
+#define DEFAULT_ACCESSES_M 4
+
+enum { R_FAULT_4K, R_FAULT_THP, R_SPLIT_MPROTECT, R_SPLIT_MUNMAP, R_COLLAPSE,
+       R_WALK_4K, R_WALK_THP, NUM_RESULTS };
+
+static const struct {
+    const char *key;
+    const char *label;
+    const char *unit;
+} result_info[NUM_RESULTS] = {
+    { "fault_4k", "fault-in 4KB", "MB/s" },
+    { "fault_thp", "fault-in THP", "MB/s" },
+    { "split_mprotect", "split via mprotect", "us/PMD" },
+    { "split_munmap", "split via munmap", "us/PMD" },
+    { "collapse", "MADV_COLLAPSE", "us/PMD" },
+    { "walk_4k", "walk 4KB", "ns/access" },
+    { "walk_thp", "walk THP", "ns/access" },
+};
+
+static uint64_t rng_state = 88172645463325252ULL;
+
+static uint64_t xorshift64(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static int thp_enabled(void) {
+    FILE *f = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+    char line[128] = "";
+
+    if (!f) {
+        return 0;
+    }
+    if (!fgets(line, sizeof(line), f)) {
+        line[0] = '\0';
+    }
+    fclose(f);
+    return strstr(line, "[always]") || strstr(line, "[madvise]");
+}
+
+// 2MB-aligned anonymous region with the given THP advice
+static char *map_region(size_t size, int huge) {
+    char *raw = mmap(NULL, size + HPAGE_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+    char *mem = (char *)(((uintptr_t)raw + HPAGE_SIZE - 1) & ~(uintptr_t)(HPAGE_SIZE - 1));
+    if (mem > raw) {
+        munmap(raw, mem - raw);
+    }
+    munmap(mem + size, raw + HPAGE_SIZE - mem);
+    madvise(mem, size, huge ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+    return mem;
+}
+
+static double fault_in(size_t size, int huge, long *thp_kb) {
+    char *mem = map_region(size, huge);
+    if (!mem) {
+        return -1;
+    }
+    long before = mt_read_kb("/proc/self/smaps_rollup", "AnonHugePages:");
+    uint64_t t0 = mt_now_ns();
+    for (size_t off = 0; off < size; off += PAGE_SIZE) {
+        mem[off] = 1;
+    }
+    uint64_t ns = mt_now_ns() - t0;
+    long after = mt_read_kb("/proc/self/smaps_rollup", "AnonHugePages:");
+    *thp_kb = (before < 0 || after < 0) ? -1 : after - before;
+    munmap(mem, size);
+    return (size / MB) / (ns / 1e9);
+}
+
+// Splits every huge PMD by changing or unmapping one 4KB page in it
+static double split(size_t size, int use_munmap) {
+    char *mem = map_region(size, 1);
+    size_t pmds = size / HPAGE_SIZE;
+    if (!mem) {
+        return -1;
+    }
+    for (size_t off = 0; off < size; off += PAGE_SIZE) {
+        mem[off] = 1;
+    }
+
+    uint64_t t0 = mt_now_ns();
+    for (size_t p = 0; p < pmds; p++) {
+        char *page = mem + p * HPAGE_SIZE + HPAGE_SIZE / 2;
+        if (use_munmap) {
+            munmap(page, PAGE_SIZE);
+        } else {
+            mprotect(page, PAGE_SIZE, PROT_READ);
+        }
+    }
+    uint64_t ns = mt_now_ns() - t0;
+
+    munmap(mem, size);
+    return ns / 1000.0 / pmds;
+}
+
+// Returns us per PMD, or -1 when MADV_COLLAPSE is unsupported
+static double collapse(size_t size) {
+    char *mem = map_region(size, 0);
+    size_t pmds = size / HPAGE_SIZE;
+    if (!mem) {
+        return -1;
+    }
+    for (size_t off = 0; off < size; off += PAGE_SIZE) {
+        mem[off] = 1;
+    }
+    madvise(mem, size, MADV_HUGEPAGE);
+
+    uint64_t t0 = mt_now_ns();
+    int ret = madvise(mem, size, MADV_COLLAPSE);
+    uint64_t ns = mt_now_ns() - t0;
+
+    munmap(mem, size);
+    return ret < 0 ? -1 : ns / 1000.0 / pmds;
+}
+
+// Chase populated from node 0, run on the last node
+static double walk(size_t size, int huge, int num_nodes, uint64_t accesses) {
+    size_t pages = size / PAGE_SIZE;
+    size_t *order = malloc(pages * sizeof(size_t));
+    size_t idx = 0;
+
+    pin_to_node(0);
+    char *mem = map_region(size, huge);
+    if (!mem || !order) {
+        free(order);
+        return -1;
+    }
+
+    // Sattolo's algorithm: one cycle through every page
+    for (size_t i = 0; i < pages; i++) {
+        order[i] = i;
+    }
+    for (size_t i = pages - 1; i > 0; i--) {
+        size_t j = xorshift64() % i;
+        size_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    for (size_t i = 0; i < pages; i++) {
+        *(size_t *)(mem + order[i] * PAGE_SIZE) = order[(i + 1) % pages];
+    }
+    free(order);
+
+    pin_to_node(num_nodes - 1);
+    for (size_t i = 0; i < pages; i++) {
+        idx = *(volatile size_t *)(mem + idx * PAGE_SIZE);
+    }
+    uint64_t t0 = mt_now_ns();
+    for (uint64_t i = 0; i < accesses; i++) {
+        idx = *(volatile size_t *)(mem + idx * PAGE_SIZE);
+    }
+    uint64_t ns = mt_now_ns() - t0;
+
+    munmap(mem, size);
+    pin_to_node(0);
+    return (double)ns / accesses;
+}
+
+int main(int argc, char **argv) {
+    size_t size = DEFAULT_REGION;
+    uint64_t accesses = DEFAULT_ACCESSES_M * 1000000ULL;
+    int num_nodes;
+    int repl_supported = 1;
+    double results[2][NUM_RESULTS];
+    long thp_kb = -1;
+
+    if (argc > 1) {
+        size = strtoul(argv[1], NULL, 0) * MB;
+    }
+    if (argc > 2) {
+        accesses = strtoull(argv[2], NULL, 0) * 1000000ULL;
+    }
+
+    mt_init("bench17");
+    printf("Bench17: THP Fault-in, Collapse and Split with Replicas\n");
+    printf("=======================================================\n");
+
+    if (numa_available() < 0) {
+        printf("SKIP: NUMA not available\n");
+        return 0;
+    }
+    num_nodes = numa_num_configured_nodes();
+    if (!thp_enabled()) {
+        printf("SKIP: Transparent huge pages are disabled\n");
+        return 0;
+    }
+
+    if (size > mt_available_memory() / 2) {
+        size = mt_available_memory() / 2;
+    }
+    size = size / HPAGE_SIZE * HPAGE_SIZE;
+    if (size < HPAGE_SIZE || accesses == 0) {
+        printf("FAIL: Region or access count too small\n");
+        return 1;
+    }
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), replication-off only\n", strerror(errno));
+        repl_supported = 0;
+    }
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+    printf("INFO: %d NUMA nodes, %zu MB region, %llu walk accesses, walks run on node %d\n",
+           num_nodes, size / MB, (unsigned long long)accesses, num_nodes - 1);
+
+    for (int mode = 0; mode < 1 + repl_supported; mode++) {
+        long kb;
+
+        if (mode) {
+            prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+        }
+        results[mode][R_FAULT_4K] = fault_in(size, 0, &kb);
+        results[mode][R_FAULT_THP] = fault_in(size, 1, &kb);
+        if (mode == 0) {
+            thp_kb = kb;
+        }
+        results[mode][R_SPLIT_MPROTECT] = split(size, 0);
+        results[mode][R_SPLIT_MUNMAP] = split(size, 1);
+        results[mode][R_COLLAPSE] = collapse(size);
+        results[mode][R_WALK_4K] = walk(size, 0, num_nodes, accesses);
+        results[mode][R_WALK_THP] = walk(size, 1, num_nodes, accesses);
+        prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+    }
+
+    if (thp_kb >= 0 && (size_t)thp_kb * 1024 < size / 2) {
+        printf("NOTE: Only %ld MB of %zu MB faulted in as THP\n", thp_kb / 1024, size / MB);
+    }
+
+    printf("\n%-20s %10s | %10s | %10s | %6s\n", "", "unit", "off", "on", "on/off");
+    for (int r = 0; r < NUM_RESULTS; r++) {
+        char name[64];
+
+        printf("%-20s %10s |", result_info[r].label, result_info[r].unit);
+        if (results[0][r] < 0) {
+            printf(" %10s | %10s | %6s\n", "n/a", "-", "-");
+            continue;
+        }
+        printf(" %10.2f |", results[0][r]);
+        snprintf(name, sizeof(name), "off_%s", result_info[r].key);
+        mt_metric(name, results[0][r], result_info[r].unit);
+
+        if (repl_supported && results[1][r] >= 0) {
+            printf(" %10.2f | %6.2f\n", results[1][r], results[1][r] / results[0][r]);
+            snprintf(name, sizeof(name), "on_%s", result_info[r].key);
+            mt_metric(name, results[1][r], result_info[r].unit);
+        } else {
+            printf(" %10s | %6s\n", "-", "-");
+        }
+    }
+
+    // Walk latency relative to 4KB pages without replication
+    double base = results[0][R_WALK_4K];
+    if (base > 0) {
+        printf("\nWalk speedup vs. 4KB/replication off:\n");
+        printf("  THP only:           %.2fx\n", base / results[0][R_WALK_THP]);
+        if (repl_supported) {
+            printf("  replication only:   %.2fx\n", base / results[1][R_WALK_4K]);
+            printf("  THP + replication:  %.2fx\n", base / results[1][R_WALK_THP]);
+        }
+    }
+
+    printf("\nBench17: DONE\n");
+    return mt_done();
+}
@@ -0,0 +1,228 @@
+// bench18.c - move_pages / migrate_pages throughput with replicas
+// Benchmark counterpart of test23. Data-rebalancing style migration: a
+// region of N 4KB pages (1 to 1M) is populated on node 0, moved to the last
+// node with move_pages() and brought back with migrate_pages(), repeatedly.
+// Both directions are timed with replication off and on; the difference is
+// the extra cost of rewriting the PTE in every replica. migrate_pages() works
+// on the whole process, so the few other pages that landed on the last node
+// come back too. On a single node the calls still walk and validate every
+// page but nothing moves.
+//
+// Usage: ./bench18 [max_pages] [runs]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <numaif.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define DEFAULT_MAX_PAGES (1024 * 1024)
+#define DEFAULT_RUNS 3
+#define MIN_PAGES_PER_POINT 16384   // small batches repeat until this many pages move
+
+typedef struct {
+    double move_pages_per_sec;
+    double migrate_pages_per_sec;
+    double move_ns_per_page;
+    double migrate_ns_per_page;
+    double moved_pct;
+} result_t;
+
+// Share of the region's pages currently on `node`
+static double pct_on_node(void **pages, int *status, size_t n, int node) {
+    size_t on_node = 0;
+
+    if (move_pages(0, n, pages, NULL, status, 0) < 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        on_node += status[i] == node;
+    }
+    return 100.0 * on_node / n;
+}
+
+static int run_point(size_t npages, int iterations, int src, int dst, int repl, result_t *r) {
+    size_t size = npages * PAGE_SIZE;
+    void **pages = malloc(npages * sizeof(void *));
+    int *nodes = malloc(npages * sizeof(int));
+    int *status = malloc(npages * sizeof(int));
+    struct bitmask *from = numa_allocate_nodemask();
+    struct bitmask *to = numa_allocate_nodemask();
+    uint64_t move_ns = 0, migrate_ns = 0;
+    int ret = -1;
+
+    if (!pages || !nodes || !status || !from || !to) {
+        errno = ENOMEM;
+        goto out;
+    }
+    // Enabled before population so every PTE exists in every replica
+    if (repl && prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        goto out;
+    }
+    char *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        goto out;
+    }
+    madvise(mem, size, MADV_NOHUGEPAGE);
+    pin_to_node(src);
+    for (size_t i = 0; i < npages; i++) {
+        mem[i * PAGE_SIZE] = (char)i;
+        pages[i] = mem + i * PAGE_SIZE;
+        nodes[i] = dst;
+    }
+    numa_bitmask_setbit(from, dst);
+    numa_bitmask_setbit(to, src);
+
+    for (int it = 0; it < iterations; it++) {
+        uint64_t t0 = mt_now_ns();
+        if (move_pages(0, npages, pages, nodes, status, MPOL_MF_MOVE) < 0) {
+            goto unmap;
+        }
+        uint64_t t1 = mt_now_ns();
+        if (it == 0) {
+            r->moved_pct = pct_on_node(pages, status, npages, dst);
+        }
+        uint64_t t2 = mt_now_ns();
+        if (numa_migrate_pages(0, from, to) < 0) {
+            goto unmap;
+        }
+        migrate_ns += mt_now_ns() - t2;
+        move_ns += t1 - t0;
+    }
+
+    double moved = (double)npages * iterations;
+    r->move_pages_per_sec = moved / (move_ns / 1e9);
+    r->migrate_pages_per_sec = moved / (migrate_ns / 1e9);
+    r->move_ns_per_page = move_ns / moved;
+    r->migrate_ns_per_page = migrate_ns / moved;
+    ret = 0;
+
+unmap:
+    munmap(mem, size);
+out:
+    if (repl) {
+        prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+    }
+    if (from) {
+        numa_free_nodemask(from);
+    }
+    if (to) {
+        numa_free_nodemask(to);
+    }
+    free(pages);
+    free(nodes);
+    free(status);
+    return ret;
+}
+
+static void emit(const char *mode, size_t npages, const result_t *r) {
+    char name[96];
+
+    snprintf(name, sizeof(name), "%s_move_pages_%zu", mode, npages);
+    mt_metric(name, r->move_pages_per_sec, "pages/s");
+    snprintf(name, sizeof(name), "%s_migrate_pages_%zu", mode, npages);
+    mt_metric(name, r->migrate_pages_per_sec, "pages/s");
+}
+
+int main(int argc, char **argv) {
+    size_t max_pages = DEFAULT_MAX_PAGES;
+    int runs = DEFAULT_RUNS;
+    int num_nodes;
+    int repl_supported = 1;
+
+    if (argc > 1) {
+        max_pages = strtoul(argv[1], NULL, 0);
+    }
+    if (argc > 2) {
+        runs = atoi(argv[2]);
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+
+    mt_init("bench18");
+    printf("Bench18: move_pages / migrate_pages Throughput with Replicas\n");
+    printf("============================================================\n");
+
+    if (numa_available() < 0) {
+        printf("SKIP: NUMA not available\n");
+        return 0;
+    }
+    num_nodes = numa_num_configured_nodes();
+    int src = 0;
+    int dst = num_nodes - 1;
+    if (num_nodes < 2) {
+        printf("NOTE: Single node, pages are validated but never moved\n");
+    }
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), replication-off only\n", strerror(errno));
+        repl_supported = 0;
+    }
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+    printf("INFO: %d NUMA nodes, node %d -> node %d (move_pages) -> node %d (migrate_pages)\n",
+           num_nodes, src, dst, src);
+    printf("INFO: up to %zu pages per batch, at least %d runs per point\n", max_pages, runs);
+    printf("\n%8s | %-34s | %s\n", "", "move_pages (forward)", "migrate_pages (back)");
+    printf("%8s | %12s %12s %8s | %12s %12s %8s\n", "pages", "off pg/s", "on pg/s",
+           "ns/pg", "off pg/s", "on pg/s", "ns/pg");
+    fflush(stdout);
+
+    int warned = 0;
+    for (size_t npages = 1; npages <= max_pages; npages *= 16) {
+        int iterations = MIN_PAGES_PER_POINT / npages;
+        result_t off, on;
+
+        if (iterations < runs) {
+            iterations = runs;
+        }
+        if (npages * PAGE_SIZE > mt_available_memory() / 2) {
+            printf("%8zu | NOTE: exceeds available memory, skipped\n", npages);
+            break;
+        }
+
+        if (run_point(npages, iterations, src, dst, 0, &off) < 0) {
+            printf("FAIL: Migration of %zu pages failed: %s\n", npages, strerror(errno));
+            return 1;
+        }
+        emit("off", npages, &off);
+        printf("%8zu | %12.0f", npages, off.move_pages_per_sec);
+        if (repl_supported) {
+            char name[96];
+
+            if (run_point(npages, iterations, src, dst, 1, &on) < 0) {
+                printf(" FAIL: Migration failed with replication: %s\n", strerror(errno));
+                return 1;
+            }
+            emit("on", npages, &on);
+            double move_extra = on.move_ns_per_page - off.move_ns_per_page;
+            double migrate_extra = on.migrate_ns_per_page - off.migrate_ns_per_page;
+            printf(" %12.0f %8.1f | %12.0f %12.0f %8.1f\n", on.move_pages_per_sec, move_extra,
+                   off.migrate_pages_per_sec, on.migrate_pages_per_sec, migrate_extra);
+            snprintf(name, sizeof(name), "move_pages_%zu_extra", npages);
+            mt_metric(name, move_extra, "ns/page");
+            snprintf(name, sizeof(name), "migrate_pages_%zu_extra", npages);
+            mt_metric(name, migrate_extra, "ns/page");
+        } else {
+            printf(" %12s %8s | %12.0f %12s %8s\n", "-", "-", off.migrate_pages_per_sec, "-", "-");
+        }
+        if (num_nodes > 1 && off.moved_pct < 100 && !warned) {
+            printf("NOTE: Only %.1f%% of pages reached node %d (memory pressure?)\n",
+                   off.moved_pct, dst);
+            warned = 1;
+        }
+        fflush(stdout);
+    }
+
+    printf("\nBench18: DONE\n");
+    return mt_done();
+}
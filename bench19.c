@@ -0,0 +1,345 @@
+// bench19.c - AutoNUMA balancing interaction with replicated page tables
+// NUMA balancing periodically turns ranges of PTEs into PROT_NONE hints and
+// takes a hinting fault on the next access, so with replication every scan
+// and every fault rewrites one PTE per replica. This runs a shifting-locality
+// workload: threads placed round-robin across nodes each sweep a slice of a
+// shared 4KB-page region, and every phase each thread moves on to its
+// neighbour's slice. It runs with kernel.numa_balancing on and off (when the
+// sysctl is writable) and replication off and on, and reports throughput,
+// system time and the /proc/vmstat deltas of numa_hint_faults,
+// numa_pages_migrated and pgmigrate_success. The original sysctl value is
+// restored on exit, including on SIGINT/SIGTERM.
+//
+// Usage: ./bench19 [region_mb] [phase_ms] [phases]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define MB (1024UL * 1024UL)
+#define DEFAULT_REGION (512 * MB)
+#define DEFAULT_PHASE_MS 2000
+#define DEFAULT_PHASES 4
+#define MAX_THREADS 64
+#define BALANCING_PATH "/proc/sys/kernel/numa_balancing"
+
+enum { C_HINT, C_HINT_LOCAL, C_MIGRATED, C_PGMIGRATE, NUM_COUNTERS };
+
+static const char *counter_keys[NUM_COUNTERS] = {
+    "numa_hint_faults", "numa_hint_faults_local", "numa_pages_migrated", "pgmigrate_success"
+};
+
+typedef struct {
+    int node;
+    int id;
+    int nthreads;
+    char *mem;
+    size_t slice;
+    uint64_t accesses;
+} worker_t;
+
+typedef struct {
+    double maccess_per_sec;
+    double sys_ms;
+    long long counters[NUM_COUNTERS];
+} result_t;
+
+static pthread_barrier_t start_barrier;
+static atomic_int phase;
+static atomic_int stop;
+static char saved_balancing[16];
+
+static int read_balancing(void) {
+    FILE *f = fopen(BALANCING_PATH, "r");
+    int value = -1;
+
+    if (f) {
+        if (fscanf(f, "%d", &value) != 1) {
+            value = -1;
+        }
+        fclose(f);
+    }
+    return value;
+}
+
+// Only open/write/close so the signal handler can use it too
+static int write_balancing(const char *value) {
+    int fd = open(BALANCING_PATH, O_WRONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t len = strlen(value);
+    int ret = write(fd, value, len) == len ? 0 : -1;
+    close(fd);
+    return ret;
+}
+
+static void restore_balancing(void) {
+    if (saved_balancing[0]) {
+        write_balancing(saved_balancing);
+    }
+}
+
+static void restore_and_exit(int sig) {
+    restore_balancing();
+    _exit(128 + sig);
+}
+
+static double sys_ms(void) {
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_stime.tv_sec * 1e3 + ru.ru_stime.tv_usec / 1e3;
+}
+
+// Sweeps slice (id + phase) % nthreads, one write per page, until stopped
+static void *sweep_thread(void *arg) {
+    worker_t *w = (worker_t *)arg;
+    uint64_t accesses = 0;
+
+    pin_to_node(w->node);
+    char *own = w->mem + w->id * w->slice;
+    for (size_t off = 0; off < w->slice; off += PAGE_SIZE) {
+        own[off] = 1;
+    }
+    pthread_barrier_wait(&start_barrier);
+
+    while (!atomic_load(&stop)) {
+        char *slice = w->mem + ((w->id + atomic_load(&phase)) % w->nthreads) * w->slice;
+        for (size_t off = 0; off < w->slice && !atomic_load(&stop); off += PAGE_SIZE) {
+            slice[off]++;
+            accesses++;
+        }
+    }
+    w->accesses = accesses;
+    return NULL;
+}
+
+static int run_config(size_t size, int nthreads, int num_nodes, int phase_ms, int phases,
+                      result_t *r) {
+    pthread_t threads[MAX_THREADS];
+    worker_t workers[MAX_THREADS];
+    long long before[NUM_COUNTERS];
+    struct timespec ts = { phase_ms / 1000, (phase_ms % 1000) * 1000000L };
+    size_t slice = size / nthreads / PAGE_SIZE * PAGE_SIZE;
+    uint64_t accesses = 0;
+
+    char *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        return -1;
+    }
+    madvise(mem, size, MADV_NOHUGEPAGE);
+
+    atomic_store(&phase, 0);
+    atomic_store(&stop, 0);
+    pthread_barrier_init(&start_barrier, NULL, nthreads + 1);
+    for (int t = 0; t < nthreads; t++) {
+        workers[t] = (worker_t){ t % num_nodes, t, nthreads, mem, slice, 0 };
+        if (pthread_create(&threads[t], NULL, sweep_thread, &workers[t]) != 0) {
+            printf("FAIL: Cannot create thread %d\n", t);
+            restore_balancing();
+            exit(1);
+        }
+    }
+    pthread_barrier_wait(&start_barrier);
+
+    // Counters bracket the shifting phases only; population is excluded
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+        before[c] = mt_vmstat(counter_keys[c]);
+    }
+    double sys_before = sys_ms();
+    uint64_t t0 = mt_now_ns();
+    for (int p = 0; p < phases; p++) {
+        nanosleep(&ts, NULL);
+        atomic_store(&phase, p + 1);
+    }
+    atomic_store(&stop, 1);
+    for (int t = 0; t < nthreads; t++) {
+        pthread_join(threads[t], NULL);
+        accesses += workers[t].accesses;
+    }
+    uint64_t ns = mt_now_ns() - t0;
+    r->sys_ms = sys_ms() - sys_before;
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+        long long after = mt_vmstat(counter_keys[c]);
+        r->counters[c] = (before[c] < 0 || after < 0) ? -1 : after - before[c];
+    }
+    pthread_barrier_destroy(&start_barrier);
+
+    r->maccess_per_sec = accesses / (ns / 1e3);
+    munmap(mem, size);
+    return 0;
+}
+
+static void emit(const char *mode, int balancing, const result_t *r) {
+    char name[96];
+    const char *bal = balancing ? "bal" : "nobal";
+
+    snprintf(name, sizeof(name), "%s_%s_throughput", mode, bal);
+    mt_metric(name, r->maccess_per_sec, "Maccess/s");
+    snprintf(name, sizeof(name), "%s_%s_sys_time", mode, bal);
+    mt_metric(name, r->sys_ms, "ms");
+    for (int c = 0; c < NUM_COUNTERS; c++) {
+        if (r->counters[c] >= 0) {
+            snprintf(name, sizeof(name), "%s_%s_%s", mode, bal, counter_keys[c]);
+            mt_metric(name, r->counters[c], "events");
+        }
+    }
+}
+
+static void print_counter(long long value) {
+    if (value >= 0) {
+        printf(" %11lld", value);
+    } else {
+        printf(" %11s", "n/a");
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t size = DEFAULT_REGION;
+    int phase_ms = DEFAULT_PHASE_MS;
+    int phases = DEFAULT_PHASES;
+    int num_nodes;
+    int nthreads;
+    int repl_supported = 1;
+    int balancing_settings[2];
+    int num_settings = 0;
+    result_t results[2][2];
+
+    if (argc > 1) {
+        size = strtoul(argv[1], NULL, 0) * MB;
+    }
+    if (argc > 2) {
+        phase_ms = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        phases = atoi(argv[3]);
+    }
+    if (phase_ms < 1) {
+        phase_ms = 1;
+    }
+    if (phases < 1) {
+        phases = 1;
+    }
+
+    mt_init("bench19");
+    printf("Bench19: AutoNUMA Balancing with Replicated Page Tables\n");
+    printf("=======================================================\n");
+
+    if (numa_available() < 0) {
+        printf("SKIP: NUMA not available\n");
+        return 0;
+    }
+    num_nodes = numa_num_configured_nodes();
+    if (num_nodes < 2) {
+        printf("NOTE: Single node, hinting faults are always local and nothing migrates\n");
+    }
+    nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads < 2) {
+        nthreads = 2;
+    }
+    if (nthreads > MAX_THREADS) {
+        nthreads = MAX_THREADS;
+    }
+
+    if (size > mt_available_memory() / 2) {
+        size = mt_available_memory() / 2 / MB * MB;
+        printf("NOTE: Region clamped to %zu MB by available memory\n", size / MB);
+    }
+    if (size / nthreads < PAGE_SIZE) {
+        printf("FAIL: Region too small for %d threads\n", nthreads);
+        return 1;
+    }
+
+    int original = read_balancing();
+    if (original < 0) {
+        printf("NOTE: %s not present, balancing-off only\n", BALANCING_PATH);
+        balancing_settings[num_settings++] = 0;
+    } else {
+        snprintf(saved_balancing, sizeof(saved_balancing), "%d\n", original);
+        signal(SIGINT, restore_and_exit);
+        signal(SIGTERM, restore_and_exit);
+        if (write_balancing("0\n") == 0 && write_balancing("1\n") == 0) {
+            balancing_settings[num_settings++] = 0;
+            balancing_settings[num_settings++] = 1;
+        } else {
+            printf("NOTE: Cannot write %s (%s), current setting (%d) only\n",
+                   BALANCING_PATH, strerror(errno), original);
+            restore_balancing();
+            saved_balancing[0] = '\0';
+            balancing_settings[num_settings++] = original ? 1 : 0;
+        }
+    }
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), replication-off only\n", strerror(errno));
+        repl_supported = 0;
+    }
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+    printf("INFO: %d NUMA nodes, %d threads, %zu MB region, %d phases x %d ms\n",
+           num_nodes, nthreads, size / MB, phases, phase_ms);
+    printf("\n%-9s %-4s | %10s %9s | %11s %11s %11s %11s\n", "balancing", "repl",
+           "Macc/s", "sys ms", "hint faults", "hint local", "migrated", "pgmigrate");
+    fflush(stdout);
+
+    for (int s = 0; s < num_settings; s++) {
+        int balancing = balancing_settings[s];
+
+        if (saved_balancing[0]) {
+            write_balancing(balancing ? "1\n" : "0\n");
+        }
+        for (int mode = 0; mode < 1 + repl_supported; mode++) {
+            result_t *r = &results[balancing][mode];
+
+            if (mode) {
+                prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+            }
+            int ret = run_config(size, nthreads, num_nodes, phase_ms, phases, r);
+            prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+            if (ret < 0) {
+                printf("FAIL: Cannot map %zu MB region\n", size / MB);
+                restore_balancing();
+                return 1;
+            }
+            emit(mode ? "on" : "off", balancing, r);
+            printf("%-9s %-4s | %10.1f %9.1f |", balancing ? "on" : "off", mode ? "on" : "off",
+                   r->maccess_per_sec, r->sys_ms);
+            for (int c = 0; c < NUM_COUNTERS; c++) {
+                print_counter(r->counters[c]);
+            }
+            printf("\n");
+            fflush(stdout);
+        }
+    }
+    restore_balancing();
+
+    // Cost of balancing itself, per replication mode
+    if (num_settings == 2) {
+        printf("\nBalancing on vs. off:\n");
+        for (int mode = 0; mode < 1 + repl_supported; mode++) {
+            printf("  replication %-3s  throughput %.2fx, sys time %+.1f ms\n",
+                   mode ? "on" : "off",
+                   results[1][mode].maccess_per_sec / results[0][mode].maccess_per_sec,
+                   results[1][mode].sys_ms - results[0][mode].sys_ms);
+        }
+    }
+
+    printf("\nBench19: DONE\n");
+    return mt_done();
+}
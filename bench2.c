@@ -0,0 +1,230 @@
+// bench2.c - GUPS random-access TLB-miss benchmark, replication A/B
+// Runs the identical random-update kernel over a multi-GB table with one
+// pinned thread per node, first with replication disabled, then with
+// mask=1 (all nodes) and with each single-node mask. Reports updates/sec
+// per node and the speedup over the disabled run.
+//
+// Usage: ./bench2 [table_mb] [updates_per_thread_millions]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <numa.h>
+#include <sched.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define MB (1024UL * 1024UL)
+#define DEFAULT_TABLE_MB 4096
+#define DEFAULT_UPDATES_M 16
+#define MAX_NODES 64
+
+typedef struct {
+    int node;
+    uint64_t updates;
+    double seconds;
+} worker_t;
+
+static uint64_t *table;
+static uint64_t table_mask;
+static pthread_barrier_t start_barrier;
+static perf_counters_t pc;
+
+// Random read-modify-write updates, HPCC RandomAccess style
+static void *gups_thread(void *arg) {
+    worker_t *w = (worker_t *)arg;
+    uint64_t x = 0x9E3779B97F4A7C15ULL ^ (uint64_t)(w->node + 1);
+
+    if (pin_to_node(w->node) < 0) {
+        printf("WARN: Cannot pin to node %d\n", w->node);
+    }
+
+    pthread_barrier_wait(&start_barrier);
+
+    uint64_t t0 = mt_now_ns();
+    for (uint64_t i = 0; i < w->updates; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        table[x & table_mask] ^= x;
+    }
+    w->seconds = (mt_now_ns() - t0) / 1e9;
+
+    return NULL;
+}
+
+// Runs one configuration; mask < 0 leaves replication disabled
+static int run_config(long mask, int num_nodes, uint64_t updates, double *ups) {
+    pthread_t threads[MAX_NODES];
+    worker_t workers[MAX_NODES];
+
+    if (mask < 0) {
+        // Best effort: stock kernels reject even the disable request
+        prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+    } else if (prctl(PR_SET_PGTABLE_REPL, mask, 0, 0, 0) < 0) {
+        return -1;
+    }
+
+    pthread_barrier_init(&start_barrier, NULL, num_nodes);
+    perf_counters_start(&pc);
+    for (int n = 0; n < num_nodes; n++) {
+        workers[n].node = n;
+        workers[n].updates = updates;
+        workers[n].seconds = 0;
+        if (pthread_create(&threads[n], NULL, gups_thread, &workers[n]) != 0) {
+            printf("FAIL: Cannot create thread for node %d\n", n);
+            exit(1);
+        }
+    }
+    for (int n = 0; n < num_nodes; n++) {
+        pthread_join(threads[n], NULL);
+        ups[n] = workers[n].updates / workers[n].seconds;
+    }
+    perf_counters_stop(&pc);
+    pthread_barrier_destroy(&start_barrier);
+
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+    return 0;
+}
+
+static void print_row(const char *label, int num_nodes, double *ups, double *base) {
+    double total = 0, base_total = 0;
+    char name[64];
+
+    printf("%-12s", label);
+    for (int n = 0; n < num_nodes; n++) {
+        printf("  %8.2f (x%.2f)", ups[n] / 1e6, ups[n] / base[n]);
+        total += ups[n];
+        base_total += base[n];
+
+        snprintf(name, sizeof(name), "%s_node%d_updates", label, n);
+        mt_metric(name, ups[n], "updates/s");
+    }
+    printf("  | total %9.2f M/s (x%.2f)\n", total / 1e6, total / base_total);
+
+    snprintf(name, sizeof(name), "%s_total_updates", label);
+    mt_metric(name, total, "updates/s");
+    snprintf(name, sizeof(name), "%s_speedup", label);
+    mt_metric(name, total / base_total, "x");
+}
+
+static void print_counters(int num_nodes, uint64_t updates) {
+    double total = (double)updates * num_nodes;
+
+    if (pc.available[PERF_EV_DTLB_MISSES]) {
+        printf("%-12s  dTLB misses/update %.3f", "",
+               perf_counters_get(&pc, PERF_EV_DTLB_MISSES) / total);
+        if (pc.available[PERF_EV_WALK_CYCLES]) {
+            printf("  walk cycles/update %.1f",
+                   perf_counters_get(&pc, PERF_EV_WALK_CYCLES) / total);
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t table_size = DEFAULT_TABLE_MB * MB;
+    uint64_t updates = DEFAULT_UPDATES_M * 1000000ULL;
+    double base[MAX_NODES], ups[MAX_NODES];
+    char label[32];
+    int num_nodes;
+
+    if (argc > 1) {
+        table_size = strtoul(argv[1], NULL, 0) * MB;
+    }
+    if (argc > 2) {
+        updates = strtoull(argv[2], NULL, 0) * 1000000ULL;
+    }
+
+    mt_init("bench2");
+    printf("Bench2: GUPS Random-Access Replication A/B\n");
+    printf("==========================================\n");
+
+    if (numa_available() < 0) {
+        printf("SKIP: NUMA not available on this system\n");
+        return 0;
+    }
+    num_nodes = numa_num_configured_nodes();
+    if (num_nodes > MAX_NODES) {
+        num_nodes = MAX_NODES;
+    }
+
+    // Leave headroom so populating the table cannot push the box into reclaim
+    long avail = sysconf(_SC_AVPHYS_PAGES);
+    if (avail > 0 && table_size > (size_t)avail * PAGE_SIZE / 2) {
+        table_size = (size_t)avail * PAGE_SIZE / 2;
+        printf("INFO: Table clamped to half of available memory\n");
+    }
+
+    // Round the table down to a power of two so indexing is a mask
+    size_t entries = 1;
+    while (entries * 2 * sizeof(uint64_t) <= table_size) {
+        entries *= 2;
+    }
+    table_size = entries * sizeof(uint64_t);
+    table_mask = entries - 1;
+
+    printf("INFO: %d NUMA nodes, table %zu MB, %llu updates per thread\n",
+           num_nodes, table_size / MB, (unsigned long long)updates);
+
+    // Populate from node 0 so page tables start out local to node 0 only
+    pin_to_node(0);
+    table = mmap(NULL, table_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (table == MAP_FAILED) {
+        printf("FAIL: mmap of %zu MB failed: %s\n", table_size / MB, strerror(errno));
+        return 1;
+    }
+    // Break up THP so the walk reaches the PTE level
+    madvise(table, table_size, MADV_NOHUGEPAGE);
+    for (size_t i = 0; i < entries; i++) {
+        table[i] = i;
+    }
+
+    printf("\n%-12s", "config");
+    for (int n = 0; n < num_nodes; n++) {
+        printf("  node%-2d Mups/s   ", n);
+    }
+    printf("\n");
+
+    // Opened before the workers exist so inherit=1 picks them up
+    perf_counters_open(&pc);
+
+    run_config(-1, num_nodes, updates, base);
+    print_row("disabled", num_nodes, base, base);
+    print_counters(num_nodes, updates);
+
+    if (run_config(1, num_nodes, updates, ups) < 0) {
+        printf("NOTE: Replication unavailable (%s), baseline only\n", strerror(errno));
+        perf_counters_close(&pc);
+        munmap(table, table_size);
+        return mt_done();
+    }
+    print_row("mask=0x1", num_nodes, ups, base);
+    print_counters(num_nodes, updates);
+
+    // Node 0 alone cannot be expressed: arg2=1 means all online nodes
+    for (int n = 1; n < num_nodes; n++) {
+        snprintf(label, sizeof(label), "mask=0x%lx", 1UL << n);
+        if (run_config(1L << n, num_nodes, updates, ups) < 0) {
+            printf("%-12s  FAIL: %s\n", label, strerror(errno));
+            continue;
+        }
+        print_row(label, num_nodes, ups, base);
+        print_counters(num_nodes, updates);
+    }
+
+    perf_counters_close(&pc);
+    munmap(table, table_size);
+
+    printf("\nBench2: DONE\n");
+    return mt_done();
+}
@@ -0,0 +1,458 @@
+// bench20.c - userfaultfd fault-resolution throughput with replicas
+// Benchmark counterpart of test24. Live-migration/lazy-restore style: faulter
+// threads touch every page of a registered region while handler threads,
+// all reading the same userfaultfd, resolve each fault. Every install has to
+// land in every replica. Measured per resolution kind:
+//   copy      MISSING faults on anonymous memory resolved with UFFDIO_COPY
+//   zeropage  MISSING faults resolved with UFFDIO_ZEROPAGE
+//   continue  MINOR faults on shmem whose page cache is already populated,
+//             resolved with UFFDIO_CONTINUE
+//   wp        write-protect faults on populated anonymous memory, resolved
+//             by clearing the protection with UFFDIO_WRITEPROTECT
+// Reports faults resolved/s and per-fault latency as seen by the faulter,
+// for 1..N handler/faulter pairs placed round-robin across nodes, with
+// replication off and on. Kinds the kernel does not offer are reported n/a.
+//
+// Usage: ./bench20 [pages] [max_handlers]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/userfaultfd.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define DEFAULT_PAGES 65536
+#define MAX_HANDLERS 64
+#define POLL_MS 10
+
+enum { K_COPY, K_ZEROPAGE, K_CONTINUE, K_WP, NUM_KINDS };
+
+static const char *kind_names[NUM_KINDS] = { "copy", "zeropage", "continue", "wp" };
+
+typedef struct {
+    int uffd;
+    int kind;
+    char *region;
+    size_t size;
+    char *region_alias;   // shmem page-cache alias for continue
+    int memfd;
+} target_t;
+
+typedef struct {
+    int node;
+    target_t *target;
+    uint64_t resolved;
+    int failed;
+    int err;              // errno of the failure
+} handler_t;
+
+typedef struct {
+    int node;
+    int kind;
+    char *start;
+    size_t pages;
+    uint64_t *samples;
+    uint64_t start_ns;
+    uint64_t end_ns;
+} faulter_t;
+
+static pthread_barrier_t start_barrier;
+static atomic_int stop;
+
+static uint64_t kind_features(int kind) {
+    switch (kind) {
+    case K_CONTINUE:
+        return UFFD_FEATURE_MINOR_SHMEM;
+    case K_WP:
+        return UFFD_FEATURE_PAGEFAULT_FLAG_WP;
+    default:
+        return 0;
+    }
+}
+
+static int create_uffd(uint64_t features) {
+    struct uffdio_api api = { .api = UFFD_API, .features = features };
+    int uffd = syscall(__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+
+    if (uffd < 0) {
+        return -1;
+    }
+    if (ioctl(uffd, UFFDIO_API, &api) < 0 || (api.features & features) != features) {
+        close(uffd);
+        return -1;
+    }
+    return uffd;
+}
+
+// Maps, populates and registers the region for one kind; -1 if unsupported
+static int setup_target(target_t *t, int kind, size_t size) {
+    struct uffdio_register reg;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    int fd = -1;
+
+    memset(t, 0, sizeof(*t));
+    t->kind = kind;
+    t->size = size;
+    t->memfd = -1;
+    t->uffd = create_uffd(kind_features(kind));
+    if (t->uffd < 0) {
+        return -1;
+    }
+
+    if (kind == K_CONTINUE) {
+        fd = memfd_create("bench20", MFD_CLOEXEC);
+        if (fd < 0 || ftruncate(fd, size) < 0) {
+            goto fail;
+        }
+        t->memfd = fd;
+        t->region_alias = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (t->region_alias == MAP_FAILED) {
+            t->region_alias = NULL;
+            goto fail;
+        }
+        for (size_t off = 0; off < size; off += PAGE_SIZE) {
+            t->region_alias[off] = 1;
+        }
+        flags = MAP_SHARED;
+    }
+
+    t->region = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if (t->region == MAP_FAILED) {
+        t->region = NULL;
+        goto fail;
+    }
+    if (kind != K_CONTINUE) {
+        madvise(t->region, size, MADV_NOHUGEPAGE);
+    }
+    if (kind == K_WP) {
+        for (size_t off = 0; off < size; off += PAGE_SIZE) {
+            t->region[off] = 1;
+        }
+    }
+
+    reg.range.start = (unsigned long)t->region;
+    reg.range.len = size;
+    reg.mode = kind == K_CONTINUE ? UFFDIO_REGISTER_MODE_MINOR :
+               kind == K_WP ? UFFDIO_REGISTER_MODE_WP : UFFDIO_REGISTER_MODE_MISSING;
+    if (ioctl(t->uffd, UFFDIO_REGISTER, &reg) < 0) {
+        goto fail;
+    }
+    if (kind == K_WP) {
+        struct uffdio_writeprotect wp = {
+            .range = { (unsigned long)t->region, size },
+            .mode = UFFDIO_WRITEPROTECT_MODE_WP,
+        };
+        if (ioctl(t->uffd, UFFDIO_WRITEPROTECT, &wp) < 0) {
+            goto fail;
+        }
+    }
+    return 0;
+
+fail:
+    if (t->region) {
+        munmap(t->region, size);
+    }
+    if (t->region_alias) {
+        munmap(t->region_alias, size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    close(t->uffd);
+    return -1;
+}
+
+static void teardown_target(target_t *t) {
+    munmap(t->region, t->size);
+    if (t->region_alias) {
+        munmap(t->region_alias, t->size);
+    }
+    if (t->memfd >= 0) {
+        close(t->memfd);
+    }
+    close(t->uffd);
+}
+
+// Another handler may have installed the page first; just wake the faulter
+static int wake(int uffd, unsigned long page) {
+    struct uffdio_range range = { page, PAGE_SIZE };
+    return ioctl(uffd, UFFDIO_WAKE, &range);
+}
+
+static int resolve(target_t *t, unsigned long page, char *src) {
+    int ret;
+
+    switch (t->kind) {
+    case K_COPY: {
+        struct uffdio_copy copy = { .dst = page, .src = (unsigned long)src, .len = PAGE_SIZE };
+        ret = ioctl(t->uffd, UFFDIO_COPY, &copy);
+        break;
+    }
+    case K_ZEROPAGE: {
+        struct uffdio_zeropage zero = { .range = { page, PAGE_SIZE } };
+        ret = ioctl(t->uffd, UFFDIO_ZEROPAGE, &zero);
+        break;
+    }
+    case K_CONTINUE: {
+        struct uffdio_continue cont = { .range = { page, PAGE_SIZE } };
+        ret = ioctl(t->uffd, UFFDIO_CONTINUE, &cont);
+        break;
+    }
+    default: {
+        struct uffdio_writeprotect wp = { .range = { page, PAGE_SIZE }, .mode = 0 };
+        return ioctl(t->uffd, UFFDIO_WRITEPROTECT, &wp);
+    }
+    }
+    if (ret < 0 && errno == EEXIST) {
+        return wake(t->uffd, page);
+    }
+    return ret;
+}
+
+// Records the error, stops the other handlers and unregisters the region,
+// then wakes every blocked faulter (unregister only wakes MISSING waiters)
+// so they retry as ordinary faults and the point ends as a failure
+static void handler_failed(handler_t *h) {
+    target_t *t = h->target;
+    struct uffdio_range range = { (unsigned long)t->region, t->size };
+
+    if (atomic_exchange(&stop, 1)) {
+        return;    // fallout of another handler's failure
+    }
+    h->failed = 1;
+    h->err = errno;
+    ioctl(t->uffd, UFFDIO_UNREGISTER, &range);
+    ioctl(t->uffd, UFFDIO_WAKE, &range);
+}
+
+static void *handler_thread(void *arg) {
+    handler_t *h = (handler_t *)arg;
+    target_t *t = h->target;
+    char *src = aligned_alloc(PAGE_SIZE, PAGE_SIZE);
+    struct pollfd pfd = { .fd = t->uffd, .events = POLLIN };
+    struct uffd_msg msg;
+
+    pin_to_node(h->node);
+    if (!src) {
+        handler_failed(h);
+        pthread_barrier_wait(&start_barrier);
+        return NULL;
+    }
+    memset(src, 0x5A, PAGE_SIZE);
+    pthread_barrier_wait(&start_barrier);
+
+    while (!atomic_load(&stop)) {
+        if (read(t->uffd, &msg, sizeof(msg)) != sizeof(msg)) {
+            if (errno != EAGAIN && errno != EINTR) {
+                handler_failed(h);
+                break;
+            }
+            poll(&pfd, 1, POLL_MS);
+            continue;
+        }
+        if (msg.event != UFFD_EVENT_PAGEFAULT) {
+            continue;
+        }
+        unsigned long page = msg.arg.pagefault.address & ~(unsigned long)(PAGE_SIZE - 1);
+        if (resolve(t, page, src) < 0) {
+            handler_failed(h);
+            break;
+        }
+        h->resolved++;
+    }
+    free(src);
+    return NULL;
+}
+
+static void *faulter_thread(void *arg) {
+    faulter_t *f = (faulter_t *)arg;
+
+    pin_to_node(f->node);
+    pthread_barrier_wait(&start_barrier);
+
+    f->start_ns = mt_now_ns();
+    for (size_t i = 0; i < f->pages; i++) {
+        char *p = f->start + i * PAGE_SIZE;
+        uint64_t t0 = mt_now_ns();
+        if (f->kind == K_WP) {
+            *(volatile char *)p = 2;
+        } else {
+            (void)*(volatile char *)p;
+        }
+        f->samples[i] = mt_now_ns() - t0;
+    }
+    f->end_ns = mt_now_ns();
+    return NULL;
+}
+
+// Returns faults/s, 0 if the kind is unsupported, -1 with errno set on failure
+static double run_point(int kind, size_t pages, int nthreads, int num_nodes,
+                        uint64_t *samples) {
+    pthread_t handler_threads[MAX_HANDLERS], faulter_threads[MAX_HANDLERS];
+    handler_t handlers[MAX_HANDLERS];
+    faulter_t faulters[MAX_HANDLERS];
+    size_t per_faulter = pages / nthreads;
+    uint64_t first_start = UINT64_MAX, last_end = 0;
+    int failed = 0;
+    int err = 0;
+    target_t target;
+
+    if (setup_target(&target, kind, pages * PAGE_SIZE) < 0) {
+        return 0;
+    }
+
+    atomic_store(&stop, 0);
+    pthread_barrier_init(&start_barrier, NULL, 2 * nthreads);
+    for (int i = 0; i < nthreads; i++) {
+        handlers[i] = (handler_t){ i % num_nodes, &target, 0, 0, 0 };
+        faulters[i] = (faulter_t){ i % num_nodes, kind,
+                                   target.region + i * per_faulter * PAGE_SIZE,
+                                   per_faulter, samples + i * per_faulter, 0, 0 };
+        if (pthread_create(&handler_threads[i], NULL, handler_thread, &handlers[i]) != 0 ||
+            pthread_create(&faulter_threads[i], NULL, faulter_thread, &faulters[i]) != 0) {
+            printf("FAIL: Cannot create thread pair %d\n", i);
+            exit(1);
+        }
+    }
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(faulter_threads[i], NULL);
+        if (faulters[i].start_ns < first_start) {
+            first_start = faulters[i].start_ns;
+        }
+        if (faulters[i].end_ns > last_end) {
+            last_end = faulters[i].end_ns;
+        }
+    }
+    atomic_store(&stop, 1);
+    for (int i = 0; i < nthreads; i++) {
+        pthread_join(handler_threads[i], NULL);
+        if (handlers[i].failed && !failed) {
+            failed = 1;
+            err = handlers[i].err;
+        }
+    }
+    pthread_barrier_destroy(&start_barrier);
+    teardown_target(&target);
+
+    if (failed) {
+        errno = err;
+        return -1;
+    }
+    return per_faulter * nthreads / ((last_end - first_start) / 1e9);
+}
+
+int main(int argc, char **argv) {
+    size_t pages = DEFAULT_PAGES;
+    int max_handlers;
+    int num_nodes = 1;
+    int repl_supported = 1;
+    double rates[2][NUM_KINDS];
+
+    max_handlers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 1) {
+        pages = strtoul(argv[1], NULL, 0);
+    }
+    if (argc > 2) {
+        max_handlers = atoi(argv[2]);
+    }
+    if (max_handlers < 1) {
+        max_handlers = 1;
+    }
+    if (max_handlers > MAX_HANDLERS) {
+        max_handlers = MAX_HANDLERS;
+    }
+
+    mt_init("bench20");
+    printf("Bench20: userfaultfd Fault Resolution with Replicas\n");
+    printf("===================================================\n");
+
+    int probe = create_uffd(0);
+    if (probe < 0) {
+        printf("NOTE: userfaultfd not available (%s)\n", strerror(errno));
+        return 0;
+    }
+    close(probe);
+
+    if (numa_available() >= 0) {
+        num_nodes = numa_num_configured_nodes();
+    }
+    if (pages * PAGE_SIZE > mt_available_memory() / 2) {
+        pages = mt_available_memory() / 2 / PAGE_SIZE;
+        printf("NOTE: Region clamped to %zu pages by available memory\n", pages);
+    }
+    if (pages < (size_t)max_handlers) {
+        printf("FAIL: Fewer pages than handler threads\n");
+        return 1;
+    }
+    uint64_t *samples = malloc(pages * sizeof(uint64_t));
+    if (!samples) {
+        printf("FAIL: Cannot allocate latency samples\n");
+        return 1;
+    }
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), replication-off only\n", strerror(errno));
+        repl_supported = 0;
+    }
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+    printf("INFO: %d NUMA nodes, %zu pages per point, up to %d handler/faulter pairs\n",
+           num_nodes, pages, max_handlers);
+
+    for (int nthreads = 1; nthreads <= max_handlers; nthreads *= 2) {
+        for (int mode = 0; mode < 1 + repl_supported; mode++) {
+            const char *label = mode ? "on" : "off";
+
+            printf("\nReplication %s, %d handler%s / %d faulter%s\n", label,
+                   nthreads, nthreads > 1 ? "s" : "", nthreads, nthreads > 1 ? "s" : "");
+            for (int k = 0; k < NUM_KINDS; k++) {
+                char name[96];
+
+                // Enabled before the region exists so every install is replicated
+                if (mode) {
+                    prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+                }
+                double rate = run_point(k, pages, nthreads, num_nodes, samples);
+                int err = errno;
+                prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+                rates[mode][k] = rate;
+
+                if (rate < 0) {
+                    printf("FAIL: %s resolution failed: %s\n", kind_names[k], strerror(err));
+                    return 1;
+                }
+                if (rate == 0) {
+                    printf("  %-8s %10s\n", kind_names[k], "n/a");
+                    continue;
+                }
+                printf("  %-8s %10.0f faults/s", kind_names[k], rate);
+                if (mode && rates[0][k] > 0) {
+                    printf("  (%.2fx off)", rate / rates[0][k]);
+                }
+                printf("\n");
+                snprintf(name, sizeof(name), "%s_%s_h%d_faults", label, kind_names[k], nthreads);
+                mt_metric(name, rate, "faults/s");
+                snprintf(name, sizeof(name), "%s_%s_h%d", label, kind_names[k], nthreads);
+                mt_report_latency(name, kind_names[k], samples, pages / nthreads * nthreads);
+            }
+        }
+    }
+
+    free(samples);
+    printf("\nBench20: DONE\n");
+    return mt_done();
+}
@@ -0,0 +1,239 @@
+// bench21.c - mlock/mlockall/MAP_POPULATE population cost with replicas
+// Benchmark counterpart of test25. Latency-critical services lock or
+// prefault their whole footprint at startup. This times populating a region
+// of each size three ways: mlock(), mlockall(MCL_CURRENT | MCL_FUTURE) and
+// mmap(MAP_POPULATE). Each runs
+//   off      without replication
+//   before   with replication enabled first, so population fills every replica
+//   after    populated without replication, then replication is enabled and
+//            copies the populated tables (populate + enable reported)
+// and the cheaper ordering is printed per point. THP is disabled for the
+// process so every region is mapped with 4KB PTEs.
+//
+// Usage: ./bench21 [max_mb] [runs]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mitosis_test.h"
+
+#ifndef PR_SET_THP_DISABLE
+#define PR_SET_THP_DISABLE 41
+#endif
+
+#define MB (1024UL * 1024UL)
+#define DEFAULT_MAX (4096 * MB)
+#define MIN_SIZE (16 * MB)
+#define DEFAULT_RUNS 3
+
+enum { M_MLOCK, M_MLOCKALL, M_POPULATE, NUM_METHODS };
+
+static const char *method_names[NUM_METHODS] = { "mlock", "mlockall", "populate" };
+
+typedef struct {
+    double off_ms;
+    double before_ms;
+    double after_populate_ms;
+    double after_enable_ms;
+} result_t;
+
+// Populates a fresh region; returns it with the population time, or NULL
+static char *populate(int method, size_t size, double *ms) {
+    char *mem;
+    uint64_t t0, t1;
+    int ret = 0;
+
+    if (method == M_POPULATE) {
+        t0 = mt_now_ns();
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        t1 = mt_now_ns();
+        if (mem == MAP_FAILED) {
+            return NULL;
+        }
+    } else {
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            return NULL;
+        }
+        t0 = mt_now_ns();
+        if (method == M_MLOCK) {
+            ret = mlock(mem, size);
+        } else {
+            ret = mlockall(MCL_CURRENT | MCL_FUTURE);
+        }
+        t1 = mt_now_ns();
+        if (ret < 0) {
+            int saved = errno;
+            munmap(mem, size);
+            errno = saved;
+            return NULL;
+        }
+    }
+    *ms = (t1 - t0) / 1e6;
+    return mem;
+}
+
+static void release(int method, char *mem, size_t size) {
+    if (method == M_MLOCKALL) {
+        munlockall();
+    } else if (method == M_MLOCK) {
+        munlock(mem, size);
+    }
+    munmap(mem, size);
+}
+
+// Averages `runs` of all three orderings (after/before only when replication works)
+static int run_point(int method, size_t size, int runs, int repl, result_t *r) {
+    memset(r, 0, sizeof(*r));
+    for (int i = 0; i < runs; i++) {
+        double ms;
+        char *mem;
+
+        if (!(mem = populate(method, size, &ms))) {
+            return -1;
+        }
+        r->off_ms += ms / runs;
+        release(method, mem, size);
+
+        if (!repl) {
+            continue;
+        }
+
+        prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+        mem = populate(method, size, &ms);
+        if (mem) {
+            release(method, mem, size);
+        }
+        prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+        if (!mem) {
+            return -1;
+        }
+        r->before_ms += ms / runs;
+
+        if (!(mem = populate(method, size, &ms))) {
+            return -1;
+        }
+        uint64_t t0 = mt_now_ns();
+        prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+        r->after_enable_ms += (mt_now_ns() - t0) / 1e6 / runs;
+        r->after_populate_ms += ms / runs;
+        release(method, mem, size);
+        prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+    }
+    return 0;
+}
+
+static void emit(int method, size_t size, int repl, const result_t *r) {
+    char name[96];
+    const char *m = method_names[method];
+
+    snprintf(name, sizeof(name), "off_%s_%zumb", m, size / MB);
+    mt_metric(name, r->off_ms, "ms");
+    if (!repl) {
+        return;
+    }
+    snprintf(name, sizeof(name), "on_before_%s_%zumb", m, size / MB);
+    mt_metric(name, r->before_ms, "ms");
+    snprintf(name, sizeof(name), "on_after_%s_%zumb_populate", m, size / MB);
+    mt_metric(name, r->after_populate_ms, "ms");
+    snprintf(name, sizeof(name), "on_after_%s_%zumb_enable", m, size / MB);
+    mt_metric(name, r->after_enable_ms, "ms");
+}
+
+int main(int argc, char **argv) {
+    size_t max_size = DEFAULT_MAX;
+    int runs = DEFAULT_RUNS;
+    int num_nodes = 1;
+    int repl_supported = 1;
+    struct rlimit rlim;
+
+    if (argc > 1) {
+        max_size = strtoul(argv[1], NULL, 0) * MB;
+    }
+    if (argc > 2) {
+        runs = atoi(argv[2]);
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+
+    mt_init("bench21");
+    printf("Bench21: mlock/mlockall/MAP_POPULATE Population with Replicas\n");
+    printf("=============================================================\n");
+
+    if (numa_available() >= 0) {
+        num_nodes = numa_num_configured_nodes();
+    }
+    if (max_size > mt_available_memory() / 2) {
+        max_size = mt_available_memory() / 2;
+        printf("NOTE: Sizes capped at %zu MB by available memory\n", max_size / MB);
+    }
+
+    // Locking needs the whole region under RLIMIT_MEMLOCK
+    rlim.rlim_cur = rlim.rlim_max = RLIM_INFINITY;
+    if (setrlimit(RLIMIT_MEMLOCK, &rlim) < 0 && getrlimit(RLIMIT_MEMLOCK, &rlim) == 0 &&
+        rlim.rlim_cur != RLIM_INFINITY) {
+        if (rlim.rlim_max > rlim.rlim_cur) {
+            rlim.rlim_cur = rlim.rlim_max;
+            setrlimit(RLIMIT_MEMLOCK, &rlim);
+        }
+        printf("NOTE: RLIMIT_MEMLOCK is %lu MB, larger lock points fail without CAP_IPC_LOCK\n",
+               (unsigned long)(rlim.rlim_cur / MB));
+    }
+    if (max_size < MIN_SIZE) {
+        printf("FAIL: Not enough memory for the smallest size\n");
+        return 1;
+    }
+    if (prctl(PR_SET_THP_DISABLE, 1, 0, 0, 0) < 0) {
+        printf("NOTE: PR_SET_THP_DISABLE failed (%s), regions may use THP\n", strerror(errno));
+    }
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), replication-off only\n", strerror(errno));
+        repl_supported = 0;
+    }
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+    printf("INFO: %d NUMA nodes, %zu MB to %zu MB, %d runs per point\n",
+           num_nodes, MIN_SIZE / MB, max_size / MB, runs);
+    printf("\n%-8s %8s | %9s | %9s | %9s %9s %9s |\n", "", "", "off", "before",
+           "after", "after", "after");
+    printf("%-8s %8s | %9s | %9s | %9s %9s %9s | %s\n", "method", "size", "ms", "ms",
+           "populate", "enable", "total", "best");
+    fflush(stdout);
+
+    for (int m = 0; m < NUM_METHODS; m++) {
+        for (size_t size = MIN_SIZE; size <= max_size; size *= 4) {
+            result_t r;
+
+            if (run_point(m, size, runs, repl_supported, &r) < 0) {
+                printf("%-8s %6zuMB | NOTE: %s failed (%s), skipped\n",
+                       method_names[m], size / MB, method_names[m], strerror(errno));
+                break;
+            }
+            emit(m, size, repl_supported, &r);
+            printf("%-8s %6zuMB | %9.2f |", method_names[m], size / MB, r.off_ms);
+            if (!repl_supported) {
+                printf(" %9s | %9s %9s %9s | %s\n", "-", "-", "-", "-", "-");
+                continue;
+            }
+            double after_total = r.after_populate_ms + r.after_enable_ms;
+            printf(" %9.2f | %9.2f %9.2f %9.2f | %s\n", r.before_ms, r.after_populate_ms,
+                   r.after_enable_ms, after_total,
+                   r.before_ms <= after_total ? "before" : "after");
+            fflush(stdout);
+        }
+    }
+
+    printf("\nBench21: DONE\n");
+    return mt_done();
+}
@@ -0,0 +1,223 @@
+// bench3.c - Pointer-chasing page-walk latency probe
+// A child forked on node 0 owns a page-table root allocated on node 0 and
+// populates a buffer whose data pages live on node 1. It then moves to node
+// 1 and chases a random single-cycle permutation with page-sized (or larger)
+// strides, so every dependent load misses the TLB and has to walk. The chase
+// runs once without and once with PR_SET_PGTABLE_REPL.
+//
+// Usage: ./bench3 [buffer_mb] [stride_bytes] [accesses_millions]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <numa.h>
+#include <numaif.h>
+#include <sched.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define MB (1024UL * 1024UL)
+#define DEFAULT_BUFFER_MB 1024
+#define DEFAULT_ACCESSES_M 10
+#define TABLE_NODE 0
+#define RUN_NODE 1
+
+// Links every slot into one random cycle (Sattolo's algorithm)
+static void build_chain(char *buf, size_t slots, size_t stride) {
+    size_t *order = malloc(slots * sizeof(size_t));
+    if (!order) {
+        printf("FAIL: Cannot allocate permutation\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < slots; i++) {
+        order[i] = i;
+    }
+    srand48(0x5EED);
+    for (size_t i = slots - 1; i > 0; i--) {
+        size_t j = (size_t)(drand48() * i);
+        size_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+
+    for (size_t i = 0; i < slots; i++) {
+        char **slot = (char **)(buf + order[i] * stride);
+        *slot = buf + order[(i + 1) % slots] * stride;
+    }
+
+    free(order);
+}
+
+static double chase(char *buf, uint64_t accesses, perf_counters_t *pc) {
+    char **p = (char **)buf;
+
+    // Short warm-up so the timed loop starts in steady state
+    for (uint64_t i = 0; i < accesses / 10; i++) {
+        p = (char **)*p;
+    }
+
+    perf_counters_start(pc);
+    uint64_t t0 = mt_now_ns();
+    for (uint64_t i = 0; i < accesses; i++) {
+        p = (char **)*p;
+    }
+    uint64_t t1 = mt_now_ns();
+    perf_counters_stop(pc);
+
+    // Keep the chain live so the loop is not optimized away
+    if (p == NULL) {
+        printf("FAIL: Broken chain\n");
+    }
+    return (double)(t1 - t0) / accesses;
+}
+
+static void print_walk_counters(const perf_counters_t *pc, uint64_t accesses) {
+    if (pc->available[PERF_EV_DTLB_MISSES]) {
+        printf("    dTLB misses/access: %.3f\n",
+               (double)perf_counters_get(pc, PERF_EV_DTLB_MISSES) / accesses);
+    }
+    if (pc->available[PERF_EV_WALK_CYCLES]) {
+        printf("    walk cycles/access: %.1f\n",
+               (double)perf_counters_get(pc, PERF_EV_WALK_CYCLES) / accesses);
+    }
+}
+
+static int run_probe(size_t size, size_t stride, uint64_t accesses) {
+    unsigned long data_mask = 1UL << RUN_NODE;
+    double base_ns, repl_ns;
+    perf_counters_t pc;
+
+    // Page tables are allocated on the faulting CPU's node
+    if (pin_to_node(TABLE_NODE) < 0) {
+        printf("FAIL: Cannot pin to node %d\n", TABLE_NODE);
+        return 1;
+    }
+
+    char *buf = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+        printf("FAIL: mmap of %zu MB failed: %s\n", size / MB, strerror(errno));
+        return 1;
+    }
+    madvise(buf, size, MADV_NOHUGEPAGE);
+
+    // Keep data local to the chasing thread so only the walk is remote
+    if (mbind(buf, size, MPOL_BIND, &data_mask, sizeof(data_mask) * 8, 0) != 0) {
+        printf("WARN: mbind to node %d failed: %s\n", RUN_NODE, strerror(errno));
+    }
+
+    size_t slots = size / stride;
+    build_chain(buf, slots, stride);
+    printf("INFO: %zu slots, stride %zu bytes, %llu accesses\n",
+           slots, stride, (unsigned long long)accesses);
+
+    if (pin_to_node(RUN_NODE) < 0) {
+        printf("FAIL: Cannot pin to node %d\n", RUN_NODE);
+        munmap(buf, size);
+        return 1;
+    }
+
+    perf_counters_open(&pc);
+
+    base_ns = chase(buf, accesses, &pc);
+    printf("\nPage-table root on node %d, thread on node %d:\n", TABLE_NODE, RUN_NODE);
+    printf("  replication off: %8.2f ns/access\n", base_ns);
+    mt_metric("repl_off_ns_per_access", base_ns, "ns");
+    print_walk_counters(&pc, accesses);
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("  replication on:  SKIP (%s)\n", strerror(errno));
+        perf_counters_close(&pc);
+        munmap(buf, size);
+        return 0;
+    }
+
+    long mask = prctl(PR_GET_PGTABLE_REPL, 0, 0, 0, 0);
+    repl_ns = chase(buf, accesses, &pc);
+    printf("  replication on:  %8.2f ns/access (mask=0x%lx)\n", repl_ns, mask);
+    mt_metric("repl_on_ns_per_access", repl_ns, "ns");
+    print_walk_counters(&pc, accesses);
+    printf("  saved by replica: %+.2f ns/access (%.1f%%)\n",
+           base_ns - repl_ns, (base_ns - repl_ns) * 100.0 / base_ns);
+
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+    perf_counters_close(&pc);
+    munmap(buf, size);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    size_t size = DEFAULT_BUFFER_MB * MB;
+    size_t stride = PAGE_SIZE;
+    uint64_t accesses = DEFAULT_ACCESSES_M * 1000000ULL;
+    int num_nodes;
+    int status;
+
+    if (argc > 1) {
+        size = strtoul(argv[1], NULL, 0) * MB;
+    }
+    if (argc > 2) {
+        stride = strtoul(argv[2], NULL, 0);
+    }
+    if (argc > 3) {
+        accesses = strtoull(argv[3], NULL, 0) * 1000000ULL;
+    }
+
+    mt_init("bench3");
+    printf("Bench3: Pointer-Chase Page-Walk Latency\n");
+    printf("=======================================\n");
+
+    // Check if NUMA is available
+    if (numa_available() < 0) {
+        printf("SKIP: NUMA not available on this system\n");
+        return 0;
+    }
+
+    num_nodes = numa_num_configured_nodes();
+    printf("INFO: System has %d configured NUMA nodes\n", num_nodes);
+
+    if (num_nodes < 2) {
+        printf("SKIP: Need at least 2 NUMA nodes for meaningful test\n");
+        return 0;
+    }
+
+    if (stride < PAGE_SIZE || stride % sizeof(char *) != 0 || size < 2 * stride) {
+        printf("FAIL: Stride must be >= %d bytes, pointer aligned, and fit twice\n",
+               PAGE_SIZE);
+        return 1;
+    }
+
+    // Fork from node 0 so the child's page-table root is allocated there
+    if (pin_to_node(TABLE_NODE) < 0) {
+        printf("FAIL: Cannot pin to node %d\n", TABLE_NODE);
+        return 1;
+    }
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        printf("FAIL: fork() failed: %s\n", strerror(errno));
+        return 1;
+    }
+    if (pid == 0) {
+        exit(run_probe(size, stride, accesses));
+    }
+
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("\nBench3: FAILED\n");
+        return 1;
+    }
+
+    printf("\nBench3: DONE\n");
+    return mt_done();
+}
@@ -0,0 +1,225 @@
+// bench4.c - Page-table memory overhead per replica node
+// Builds the mapping shapes the correctness tests use (4KB pages as in
+// test14, a sparse 1GB PUD span as in test15, THP as in test22 and a file
+// mapping as in test29), then samples VmPTE from /proc/self/status and
+// PageTables from /proc/meminfo before and after enabling replication.
+// Reports page-table bytes per GB mapped, per replica.
+//
+// Usage: ./bench4 [size_mb]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define PMD_SIZE (512UL * PAGE_SIZE)  // 2MB
+#define PUD_SIZE (512UL * PMD_SIZE)   // 1GB
+#define MB (1024UL * 1024UL)
+#define GB (1024UL * MB)
+#define DEFAULT_SIZE_MB 1024
+
+typedef struct {
+    long vm_pte_kb;
+    long page_tables_kb;
+} pt_sample_t;
+
+typedef enum { SHAPE_4K, SHAPE_PUD_SPAN, SHAPE_THP, SHAPE_FILE } shape_t;
+
+static const char *shape_names[] = {
+    "4KB pages (test14)",
+    "sparse 1GB PUD span (test15)",
+    "THP (test22)",
+    "file MAP_SHARED (test29)",
+};
+
+static const char *shape_keys[] = { "4k", "pud_span", "thp", "file" };
+
+static const char *filename = "/tmp/mitosis_bench4.dat";
+
+static pt_sample_t sample(void) {
+    pt_sample_t s;
+    s.vm_pte_kb = mt_read_kb("/proc/self/status", "VmPTE:");
+    s.page_tables_kb = mt_read_kb("/proc/meminfo", "PageTables:");
+    return s;
+}
+
+// Maps and populates one shape of the given virtual size
+static char *build_shape(shape_t shape, size_t size) {
+    volatile char sink;
+    char *mem, *base;
+    int fd;
+
+    switch (shape) {
+    case SHAPE_4K:
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            return NULL;
+        }
+        madvise(mem, size, MADV_NOHUGEPAGE);
+        for (size_t i = 0; i < size; i += PAGE_SIZE) {
+            mem[i] = 1;
+        }
+        return mem;
+
+    case SHAPE_PUD_SPAN:
+        // One page per PMD across a PUD-aligned span: worst-case PTE pages
+        base = mmap(NULL, size + PUD_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (base == MAP_FAILED) {
+            return NULL;
+        }
+        mem = (char *)(((uintptr_t)base + PUD_SIZE - 1) & ~(PUD_SIZE - 1));
+        if (mem > base) {
+            munmap(base, mem - base);
+        }
+        munmap(mem + size, base + size + PUD_SIZE - (mem + size));
+        madvise(mem, size, MADV_NOHUGEPAGE);
+        for (size_t i = 0; i < size; i += PMD_SIZE) {
+            mem[i] = 1;
+        }
+        return mem;
+
+    case SHAPE_THP:
+        base = mmap(NULL, size + PMD_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            return NULL;
+        }
+        mem = (char *)(((uintptr_t)base + PMD_SIZE - 1) & ~(PMD_SIZE - 1));
+        if (mem > base) {
+            munmap(base, mem - base);
+        }
+        munmap(mem + size, base + size + PMD_SIZE - (mem + size));
+        if (madvise(mem, size, MADV_HUGEPAGE) != 0) {
+            printf("NOTE: MADV_HUGEPAGE failed: %s\n", strerror(errno));
+        }
+        for (size_t i = 0; i < size; i += PAGE_SIZE) {
+            mem[i] = 1;
+        }
+        return mem;
+
+    case SHAPE_FILE:
+        fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return NULL;
+        }
+        if (ftruncate(fd, size) != 0) {
+            close(fd);
+            unlink(filename);
+            return NULL;
+        }
+        mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mem == MAP_FAILED) {
+            unlink(filename);
+            return NULL;
+        }
+        for (size_t i = 0; i < size; i += PAGE_SIZE) {
+            sink = mem[i];
+        }
+        (void)sink;
+        return mem;
+    }
+    return NULL;
+}
+
+static void destroy_shape(shape_t shape, char *mem, size_t size) {
+    munmap(mem, size);
+    if (shape == SHAPE_FILE) {
+        unlink(filename);
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t size = DEFAULT_SIZE_MB * MB;
+    int repl_supported = 1;
+
+    if (argc > 1) {
+        size = strtoul(argv[1], NULL, 0) * MB;
+    }
+    size &= ~(PMD_SIZE - 1);
+    if (size == 0) {
+        size = PMD_SIZE;
+    }
+
+    mt_init("bench4");
+    printf("Bench4: Page-Table Memory Overhead per Replica\n");
+    printf("==============================================\n");
+    printf("INFO: %zu MB per shape\n", size / MB);
+
+    if (mt_read_kb("/proc/self/status", "VmPTE:") < 0) {
+        printf("FAIL: VmPTE not found in /proc/self/status\n");
+        return 1;
+    }
+
+    for (shape_t shape = SHAPE_4K; shape <= SHAPE_FILE; shape++) {
+        pt_sample_t before, populated, replicated, disabled;
+        char name[64];
+
+        printf("\n--- %s ---\n", shape_names[shape]);
+
+        before = sample();
+        char *mem = build_shape(shape, size);
+        if (!mem) {
+            printf("NOTE: Could not build shape, skipped: %s\n", strerror(errno));
+            continue;
+        }
+        populated = sample();
+
+        double mapped_gb = (double)size / GB;
+        long base_pte = populated.vm_pte_kb - before.vm_pte_kb;
+        printf("  VmPTE  single copy:   %8ld kB  (%.1f kB/GB)\n",
+               base_pte, base_pte / mapped_gb);
+        snprintf(name, sizeof(name), "%s_single_copy", shape_keys[shape]);
+        mt_metric(name, base_pte / mapped_gb, "kB/GB");
+
+        if (!repl_supported || prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+            if (repl_supported) {
+                printf("  NOTE: Replication unavailable (%s), baseline only\n",
+                       strerror(errno));
+                repl_supported = 0;
+            }
+            destroy_shape(shape, mem, size);
+            continue;
+        }
+
+        long mask = prctl(PR_GET_PGTABLE_REPL, 0, 0, 0, 0);
+        int replicas = __builtin_popcountl(mask);
+        replicated = sample();
+        prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+        disabled = sample();
+
+        long vm_extra = replicated.vm_pte_kb - populated.vm_pte_kb;
+        long sys_extra = replicated.page_tables_kb - populated.page_tables_kb;
+
+        printf("  VmPTE  replicated:    %8ld kB  (mask=0x%lx, %d replicas)\n",
+               replicated.vm_pte_kb - before.vm_pte_kb, mask, replicas);
+        printf("  VmPTE  after disable: %8ld kB\n",
+               disabled.vm_pte_kb - before.vm_pte_kb);
+        if (replicas <= 1) {
+            // No extra copy exists, so any delta is noise
+            printf("  NOTE: %d replica, no per-replica overhead to report\n", replicas);
+        } else {
+            printf("  overhead (VmPTE):      %8.1f kB per GB per extra replica\n",
+                   vm_extra / mapped_gb / (replicas - 1));
+            printf("  overhead (PageTables): %8.1f kB per GB per extra replica\n",
+                   sys_extra / mapped_gb / (replicas - 1));
+            snprintf(name, sizeof(name), "%s_overhead_per_replica", shape_keys[shape]);
+            mt_metric(name, vm_extra / mapped_gb / (replicas - 1), "kB/GB");
+        }
+
+        destroy_shape(shape, mem, size);
+    }
+
+    printf("\nBench4: DONE\n");
+    return mt_done();
+}
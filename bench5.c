@@ -0,0 +1,236 @@
+// bench5.c - mmap/fault/munmap throughput and replica teardown cost
+// Threads placed round-robin across nodes map a region, fault every page and
+// unmap it in a tight loop, for regions from 4KB to 1GB and 1..N threads.
+// Regions are MADV_NOHUGEPAGE so teardown frees 4KB PTEs. Reports
+// map/fault/unmap cycles/sec, average munmap latency and TLB shootdowns per
+// cycle, with replication off and on, and the on/off ratio.
+//
+// Usage: ./bench5 [max_threads] [bytes_per_thread_mb]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define KB 1024UL
+#define MB (1024UL * KB)
+#define GB (1024UL * MB)
+#define DEFAULT_BYTES_PER_THREAD (512 * MB)
+#define MIN_ITERATIONS 4
+#define MAX_THREADS 256
+
+static const size_t region_sizes[] = {
+    4 * KB, 64 * KB, 1 * MB, 16 * MB, 256 * MB, 1 * GB
+};
+#define NUM_SIZES (sizeof(region_sizes) / sizeof(region_sizes[0]))
+
+typedef struct {
+    int node;
+    size_t size;
+    int iterations;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t munmap_ns;
+    int failed;
+} worker_t;
+
+typedef struct {
+    double ops_per_sec;
+    double munmap_us;
+    double shootdowns;
+} result_t;
+
+static pthread_barrier_t start_barrier;
+
+static void *map_unmap_thread(void *arg) {
+    worker_t *w = (worker_t *)arg;
+
+    pin_to_node(w->node);
+    pthread_barrier_wait(&start_barrier);
+    w->start_ns = mt_now_ns();
+
+    for (int i = 0; i < w->iterations; i++) {
+        char *mem = mmap(NULL, w->size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            w->failed = 1;
+            return NULL;
+        }
+        madvise(mem, w->size, MADV_NOHUGEPAGE);
+
+        // Fault every page so teardown has PTEs to free on every replica
+        for (size_t off = 0; off < w->size; off += PAGE_SIZE) {
+            mem[off] = (char)i;
+        }
+
+        uint64_t t0 = mt_now_ns();
+        munmap(mem, w->size);
+        w->munmap_ns += mt_now_ns() - t0;
+    }
+    w->end_ns = mt_now_ns();
+    return NULL;
+}
+
+static int run_point(size_t size, int nthreads, int num_nodes,
+                     size_t bytes_per_thread, result_t *r) {
+    pthread_t threads[MAX_THREADS];
+    worker_t workers[MAX_THREADS];
+    int iterations = bytes_per_thread / size;
+    uint64_t munmap_total = 0;
+    uint64_t first_start = UINT64_MAX, last_end = 0;
+
+    if (iterations < MIN_ITERATIONS) {
+        iterations = MIN_ITERATIONS;
+    }
+
+    pthread_barrier_init(&start_barrier, NULL, nthreads + 1);
+    for (int t = 0; t < nthreads; t++) {
+        memset(&workers[t], 0, sizeof(worker_t));
+        workers[t].node = t % num_nodes;
+        workers[t].size = size;
+        workers[t].iterations = iterations;
+        if (pthread_create(&threads[t], NULL, map_unmap_thread, &workers[t]) != 0) {
+            printf("FAIL: Cannot create thread %d\n", t);
+            exit(1);
+        }
+    }
+
+    long long tlb_before = mt_tlb_shootdowns();
+    pthread_barrier_wait(&start_barrier);
+
+    // Workers time themselves; the main thread may not run again until they finish
+    int failed = 0;
+    for (int t = 0; t < nthreads; t++) {
+        pthread_join(threads[t], NULL);
+        munmap_total += workers[t].munmap_ns;
+        failed |= workers[t].failed;
+        if (workers[t].start_ns < first_start) {
+            first_start = workers[t].start_ns;
+        }
+        if (workers[t].end_ns > last_end) {
+            last_end = workers[t].end_ns;
+        }
+    }
+
+    uint64_t elapsed = last_end - first_start;
+    long long tlb_after = mt_tlb_shootdowns();
+    pthread_barrier_destroy(&start_barrier);
+
+    if (failed) {
+        return -1;
+    }
+
+    double ops = (double)iterations * nthreads;
+    r->ops_per_sec = ops / (elapsed / 1e9);
+    r->munmap_us = munmap_total / ops / 1000.0;
+    r->shootdowns = tlb_before < 0 ? -1 : (tlb_after - tlb_before) / ops;
+    return 0;
+}
+
+static void emit(const char *mode, size_t size, int nthreads, const result_t *r) {
+    char name[96];
+
+    snprintf(name, sizeof(name), "%s_%zukb_t%d_ops", mode, size / KB, nthreads);
+    mt_metric(name, r->ops_per_sec, "ops/s");
+    snprintf(name, sizeof(name), "%s_%zukb_t%d_munmap", mode, size / KB, nthreads);
+    mt_metric(name, r->munmap_us, "us");
+    if (r->shootdowns >= 0) {
+        snprintf(name, sizeof(name), "%s_%zukb_t%d_shootdowns", mode, size / KB, nthreads);
+        mt_metric(name, r->shootdowns, "ipis/op");
+    }
+}
+
+int main(int argc, char **argv) {
+    int max_threads;
+    size_t bytes_per_thread = DEFAULT_BYTES_PER_THREAD;
+    int num_nodes = 1;
+    int repl_supported = 1;
+
+    mt_init("bench5");
+    printf("Bench5: mmap/munmap Throughput with Replica Teardown\n");
+    printf("====================================================\n");
+
+    if (numa_available() >= 0) {
+        num_nodes = numa_num_configured_nodes();
+    }
+    max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 1) {
+        max_threads = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        bytes_per_thread = strtoul(argv[2], NULL, 0) * MB;
+    }
+    if (max_threads < 1) {
+        max_threads = 1;
+    }
+    if (max_threads > MAX_THREADS) {
+        max_threads = MAX_THREADS;
+    }
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), replication-off only\n", strerror(errno));
+        repl_supported = 0;
+    }
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+    printf("INFO: %d NUMA nodes, up to %d threads, %zu MB mapped per thread per point\n",
+           num_nodes, max_threads, bytes_per_thread / MB);
+    printf("\n%10s %7s | %12s %10s %8s | %12s %10s %8s | %6s\n",
+           "size", "threads", "off ops/s", "munmap us", "tlb/op",
+           "on ops/s", "munmap us", "tlb/op", "ratio");
+
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        size_t size = region_sizes[s];
+
+        // Powers of two, always ending with every CPU
+        for (int nthreads = 1; ; ) {
+            result_t off, on;
+
+            if (size * nthreads > mt_available_memory() / 2) {
+                printf("%8zuKB %7d | NOTE: exceeds available memory, skipped\n",
+                       size / KB, nthreads);
+                break;
+            }
+
+            if (run_point(size, nthreads, num_nodes, bytes_per_thread, &off) < 0) {
+                printf("FAIL: mmap failed at %zu KB x %d threads\n", size / KB, nthreads);
+                return 1;
+            }
+            emit("off", size, nthreads, &off);
+            printf("%8zuKB %7d | %12.0f %10.2f %8.2f |", size / KB, nthreads,
+                   off.ops_per_sec, off.munmap_us, off.shootdowns);
+
+            if (repl_supported) {
+                prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+                int ret = run_point(size, nthreads, num_nodes, bytes_per_thread, &on);
+                prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+                if (ret < 0) {
+                    printf(" FAIL: mmap failed with replication\n");
+                    return 1;
+                }
+                emit("on", size, nthreads, &on);
+                printf(" %12.0f %10.2f %8.2f | %6.2f\n", on.ops_per_sec, on.munmap_us,
+                       on.shootdowns, on.ops_per_sec / off.ops_per_sec);
+            } else {
+                printf(" %12s %10s %8s | %6s\n", "-", "-", "-", "-");
+            }
+
+            if (nthreads == max_threads) {
+                break;
+            }
+            nthreads = nthreads * 2 < max_threads ? nthreads * 2 : max_threads;
+        }
+    }
+
+    printf("\nBench5: DONE\n");
+    return mt_done();
+}
@@ -0,0 +1,218 @@
+// bench6.c - mremap latency vs. region size and replica count
+// Timed variant of the test15 shapes. For each populated region size it
+// measures in-place growth into a hole, shrink back, a MREMAP_FIXED move
+// (which moves the page tables of every replica) and a growth forced to move
+// because the next page is mapped. Regions are MADV_NOHUGEPAGE so every size
+// is mapped with 4KB PTEs, never huge PMDs. Reported per replica count,
+// replication off first.
+//
+// Usage: ./bench6 [runs] [max_size_mb]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define PMD_SIZE (512 * PAGE_SIZE)  // 2MB
+#define KB 1024UL
+#define MB (1024UL * KB)
+#define GB (1024UL * MB)
+#define DEFAULT_RUNS 10
+#define MAX_CONFIGS 64
+
+enum { OP_GROW, OP_SHRINK, OP_MOVE, OP_GROW_MOVE, NUM_OPS };
+static const char *op_names[NUM_OPS] = { "grow", "shrink", "move", "grow_mv" };
+
+static const size_t region_sizes[] = {
+    64 * KB, 2 * MB, 8 * MB, 64 * MB, 512 * MB, 1 * GB
+};
+#define NUM_SIZES (sizeof(region_sizes) / sizeof(region_sizes[0]))
+
+static void touch(char *mem, size_t size, char val) {
+    for (size_t off = 0; off < size; off += PAGE_SIZE) {
+        mem[off] = val;
+    }
+}
+
+static uint64_t timed_mremap(void **addr, void *old, size_t old_size,
+                             size_t new_size, int flags, void *target) {
+    uint64_t t0 = mt_now_ns();
+    *addr = mremap(old, old_size, new_size, flags, target);
+    return mt_now_ns() - t0;
+}
+
+// One round of all four operations on a PMD-aligned region of `size`.
+// Layout inside a PROT_NONE reservation: [region][hole][move target][guard]
+static int run_once(size_t size, int run, uint64_t *samples[NUM_OPS]) {
+    size_t total = 3 * size + PMD_SIZE + PAGE_SIZE;
+    char *res = mmap(NULL, total, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    void *addr;
+
+    if (res == MAP_FAILED) {
+        return -1;
+    }
+    char *base = (char *)(((uintptr_t)res + PMD_SIZE - 1) & ~(uintptr_t)(PMD_SIZE - 1));
+    char *target = base + 2 * size;
+
+    if (mmap(base, size, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+        munmap(res, total);
+        return -1;
+    }
+    madvise(base, size, MADV_NOHUGEPAGE);
+    touch(base, size, (char)run);
+    munmap(base + size, size);
+
+    // In-place growth into the hole: only the new range gets page tables
+    samples[OP_GROW][run] = timed_mremap(&addr, base, size, 2 * size, 0, NULL);
+    if (addr != base) {
+        printf("FAIL: In-place growth of %zu KB did not stay in place\n", size / KB);
+        munmap(res, total);
+        return -1;
+    }
+
+    // Shrink zaps the populated upper half on every replica
+    touch(base + size, size, (char)run);
+    samples[OP_SHRINK][run] = timed_mremap(&addr, base, 2 * size, size, 0, NULL);
+    if (addr != base) {
+        printf("FAIL: Shrink of %zu KB failed: %s\n", size / KB, strerror(errno));
+        munmap(res, total);
+        return -1;
+    }
+
+    // Fixed move: every PTE is moved in every replica
+    samples[OP_MOVE][run] = timed_mremap(&addr, base, size, size,
+                                         MREMAP_MAYMOVE | MREMAP_FIXED, target);
+    if (addr != target || *(char *)target != (char)run) {
+        printf("FAIL: MREMAP_FIXED move of %zu KB failed\n", size / KB);
+        munmap(res, total);
+        return -1;
+    }
+
+    // The reservation tail right after target blocks growth, forcing a move
+    samples[OP_GROW_MOVE][run] = timed_mremap(&addr, target, size, 2 * size,
+                                              MREMAP_MAYMOVE, NULL);
+    if (addr == MAP_FAILED || *(char *)addr != (char)run) {
+        printf("FAIL: Growth-by-move of %zu KB failed\n", size / KB);
+        munmap(res, total);
+        return -1;
+    }
+
+    munmap(addr, 2 * size);
+    munmap(res, total);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int runs = DEFAULT_RUNS;
+    size_t max_size = 1 * GB;
+    unsigned long masks[MAX_CONFIGS];
+    int num_configs = 0;
+    int num_nodes = 1;
+    uint64_t *samples[NUM_OPS];
+
+    if (argc > 1) {
+        runs = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        max_size = strtoul(argv[2], NULL, 0) * MB;
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+
+    mt_init("bench6");
+    printf("Bench6: mremap Latency vs. Region Size and Replica Count\n");
+    printf("========================================================\n");
+
+    if (numa_available() >= 0) {
+        num_nodes = numa_num_configured_nodes();
+    }
+
+    // Replication off first, then 2..N node masks
+    masks[num_configs++] = 0;
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), baseline only\n", strerror(errno));
+    } else {
+        prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+        for (int w = 2; w <= num_nodes && num_configs < MAX_CONFIGS; w++) {
+            unsigned long mask = mt_node_mask(w);
+            if (mask) {
+                masks[num_configs++] = mask;
+            }
+        }
+    }
+
+    printf("INFO: %d NUMA nodes, %d runs per point, max size %zu MB\n",
+           num_nodes, runs, max_size / MB);
+
+    for (int op = 0; op < NUM_OPS; op++) {
+        samples[op] = calloc(runs, sizeof(uint64_t));
+        if (!samples[op]) {
+            printf("FAIL: Could not allocate sample buffers\n");
+            return 1;
+        }
+    }
+
+    for (int c = 0; c < num_configs; c++) {
+        int replicas = 0;
+
+        if (masks[c]) {
+            if (prctl(PR_SET_PGTABLE_REPL, masks[c], 0, 0, 0) < 0) {
+                printf("\nNOTE: mask=0x%lx rejected (%s), skipped\n", masks[c], strerror(errno));
+                continue;
+            }
+            replicas = __builtin_popcountl(prctl(PR_GET_PGTABLE_REPL, 0, 0, 0, 0));
+        }
+        printf("\n--- Replicas: %d (mask=0x%lx) ---\n", replicas, masks[c]);
+
+        for (size_t s = 0; s < NUM_SIZES; s++) {
+            size_t size = region_sizes[s];
+
+            if (size > max_size) {
+                break;
+            }
+            if (2 * size > mt_available_memory() / 2) {
+                printf("\nNOTE: %zu KB exceeds available memory, skipped\n", size / KB);
+                break;
+            }
+
+            for (int r = 0; r < runs; r++) {
+                if (run_once(size, r, samples) < 0) {
+                    printf("FAIL: mremap round failed at %zu KB\n", size / KB);
+                    return 1;
+                }
+            }
+
+            printf("\nSize %zu KB (%.2f PMDs)\n", size / KB, (double)size / PMD_SIZE);
+            for (int op = 0; op < NUM_OPS; op++) {
+                char name[96];
+                snprintf(name, sizeof(name), "r%d_%zukb_%s", replicas, size / KB, op_names[op]);
+                mt_report_latency(name, op_names[op], samples[op], runs);
+            }
+
+            // Samples are sorted now; compare medians
+            double grow = samples[OP_GROW][(runs - 1) / 2];
+            double move = samples[OP_GROW_MOVE][(runs - 1) / 2];
+            printf("  grow-by-move / in-place p50 ratio: %.2f\n", grow > 0 ? move / grow : 0);
+        }
+
+        prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+    }
+
+    for (int op = 0; op < NUM_OPS; op++) {
+        free(samples[op]);
+    }
+
+    printf("\nBench6: DONE\n");
+    return mt_done();
+}
@@ -0,0 +1,271 @@
+// bench7.c - MADV_DONTNEED / MADV_FREE / MADV_PAGEOUT cost with replicas
+// Allocator-style purging: threads placed round-robin across nodes dirty a
+// private region, then advise it away, in a loop. Sweeps region size (4KB to
+// 64MB, MADV_NOHUGEPAGE so every region is mapped with 4KB PTEs), thread
+// count and advice, and reports average madvise latency and aggregate advised
+// throughput with replication off and on. DONTNEED and PAGEOUT zap the PTEs
+// in the call; MADV_FREE only marks the pages lazily free and leaves the
+// teardown to reclaim, so its rate is not a zap rate.
+//
+// Usage: ./bench7 [max_threads] [bytes_per_thread_mb]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mitosis_test.h"
+
+#ifndef MADV_FREE
+#define MADV_FREE 8
+#endif
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT 21
+#endif
+
+#define PAGE_SIZE 4096
+#define KB 1024UL
+#define MB (1024UL * KB)
+#define DEFAULT_BYTES_PER_THREAD (256 * MB)
+#define MIN_ITERATIONS 4
+#define MAX_THREADS 256
+
+static const size_t region_sizes[] = {
+    4 * KB, 64 * KB, 1 * MB, 16 * MB, 64 * MB
+};
+#define NUM_SIZES (sizeof(region_sizes) / sizeof(region_sizes[0]))
+
+static const struct {
+    int advice;
+    const char *name;
+    const char *label;
+    const char *note;
+} advices[] = {
+    { MADV_DONTNEED, "dontneed", "MADV_DONTNEED", NULL },
+    { MADV_FREE, "free", "MADV_FREE",
+      "MADV_FREE only marks pages lazily free; PTEs are torn down later by reclaim" },
+    { MADV_PAGEOUT, "pageout", "MADV_PAGEOUT", NULL },
+};
+#define NUM_ADVICES (sizeof(advices) / sizeof(advices[0]))
+
+typedef struct {
+    int node;
+    int advice;
+    size_t size;
+    int iterations;
+    uint64_t madvise_ns;
+    int failed;
+} worker_t;
+
+typedef struct {
+    double latency_us;
+    double gb_per_sec;
+} result_t;
+
+static pthread_barrier_t start_barrier;
+
+static void *purge_thread(void *arg) {
+    worker_t *w = (worker_t *)arg;
+
+    pin_to_node(w->node);
+    char *mem = mmap(NULL, w->size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        w->failed = 1;
+    } else {
+        madvise(mem, w->size, MADV_NOHUGEPAGE);
+    }
+    pthread_barrier_wait(&start_barrier);
+    if (w->failed) {
+        return NULL;
+    }
+
+    for (int i = 0; i < w->iterations; i++) {
+        // Re-dirty every page so each call has populated PTEs on every replica
+        for (size_t off = 0; off < w->size; off += PAGE_SIZE) {
+            mem[off] = (char)i;
+        }
+
+        uint64_t t0 = mt_now_ns();
+        if (madvise(mem, w->size, w->advice) < 0) {
+            w->failed = 1;
+            break;
+        }
+        w->madvise_ns += mt_now_ns() - t0;
+    }
+
+    munmap(mem, w->size);
+    return NULL;
+}
+
+static int run_point(int advice, size_t size, int nthreads, int num_nodes,
+                     size_t bytes_per_thread, result_t *r) {
+    pthread_t threads[MAX_THREADS];
+    worker_t workers[MAX_THREADS];
+    int iterations = bytes_per_thread / size;
+    double calls = 0, gb_per_sec = 0;
+    uint64_t madvise_total = 0;
+    int failed = 0;
+
+    if (iterations < MIN_ITERATIONS) {
+        iterations = MIN_ITERATIONS;
+    }
+
+    pthread_barrier_init(&start_barrier, NULL, nthreads);
+    for (int t = 0; t < nthreads; t++) {
+        memset(&workers[t], 0, sizeof(worker_t));
+        workers[t].node = t % num_nodes;
+        workers[t].advice = advice;
+        workers[t].size = size;
+        workers[t].iterations = iterations;
+        if (pthread_create(&threads[t], NULL, purge_thread, &workers[t]) != 0) {
+            printf("FAIL: Cannot create thread %d\n", t);
+            exit(1);
+        }
+    }
+
+    for (int t = 0; t < nthreads; t++) {
+        pthread_join(threads[t], NULL);
+        failed |= workers[t].failed;
+        madvise_total += workers[t].madvise_ns;
+        calls += iterations;
+        // Threads advise concurrently, so per-thread rates add up
+        if (workers[t].madvise_ns) {
+            gb_per_sec += (double)size * iterations / workers[t].madvise_ns;
+        }
+    }
+    pthread_barrier_destroy(&start_barrier);
+
+    if (failed) {
+        return -1;
+    }
+
+    r->latency_us = madvise_total / calls / 1000.0;
+    r->gb_per_sec = gb_per_sec;
+    return 0;
+}
+
+static void emit(const char *mode, const char *advice, size_t size, int nthreads,
+                 const result_t *r) {
+    char name[96];
+
+    snprintf(name, sizeof(name), "%s_%s_%zukb_t%d_latency", mode, advice, size / KB, nthreads);
+    mt_metric(name, r->latency_us, "us");
+    snprintf(name, sizeof(name), "%s_%s_%zukb_t%d_advised", mode, advice, size / KB, nthreads);
+    mt_metric(name, r->gb_per_sec, "GB/s");
+}
+
+int main(int argc, char **argv) {
+    int max_threads;
+    size_t bytes_per_thread = DEFAULT_BYTES_PER_THREAD;
+    int num_nodes = 1;
+    int repl_supported = 1;
+
+    mt_init("bench7");
+    printf("Bench7: MADV_DONTNEED / MADV_FREE / MADV_PAGEOUT with Replicas\n");
+    printf("===============================================================\n");
+
+    if (numa_available() >= 0) {
+        num_nodes = numa_num_configured_nodes();
+    }
+    max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 1) {
+        max_threads = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        bytes_per_thread = strtoul(argv[2], NULL, 0) * MB;
+    }
+    if (max_threads < 1) {
+        max_threads = 1;
+    }
+    if (max_threads > MAX_THREADS) {
+        max_threads = MAX_THREADS;
+    }
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), replication-off only\n", strerror(errno));
+        repl_supported = 0;
+    }
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+    printf("INFO: %d NUMA nodes, up to %d threads, %zu MB advised per thread per point\n",
+           num_nodes, max_threads, bytes_per_thread / MB);
+
+    for (size_t a = 0; a < NUM_ADVICES; a++) {
+        // Older kernels reject MADV_FREE (4.5) and MADV_PAGEOUT (5.4)
+        char *probe = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        int ok = probe != MAP_FAILED && madvise(probe, PAGE_SIZE, advices[a].advice) == 0;
+        int err = errno;
+        if (probe != MAP_FAILED) {
+            munmap(probe, PAGE_SIZE);
+        }
+        if (!ok) {
+            printf("\nNOTE: %s not supported (%s), skipped\n",
+                   advices[a].label, strerror(err));
+            continue;
+        }
+
+        printf("\n--- %s ---\n", advices[a].label);
+        if (advices[a].note) {
+            printf("NOTE: %s\n", advices[a].note);
+        }
+        printf("%10s %7s | %10s %9s | %10s %9s | %6s\n", "size", "threads",
+               "off us", "off GB/s", "on us", "on GB/s", "on/off");
+
+        for (size_t s = 0; s < NUM_SIZES; s++) {
+            size_t size = region_sizes[s];
+
+            // Powers of two, always ending with every CPU
+            for (int nthreads = 1; ; ) {
+                result_t off, on;
+
+                if (size * nthreads > mt_available_memory() / 2) {
+                    printf("%8zuKB %7d | NOTE: exceeds available memory, skipped\n",
+                           size / KB, nthreads);
+                    break;
+                }
+
+                if (run_point(advices[a].advice, size, nthreads, num_nodes,
+                              bytes_per_thread, &off) < 0) {
+                    printf("FAIL: %s failed at %zu KB x %d threads\n",
+                           advices[a].label, size / KB, nthreads);
+                    return 1;
+                }
+                emit("off", advices[a].name, size, nthreads, &off);
+                printf("%8zuKB %7d | %10.2f %9.2f |", size / KB, nthreads,
+                       off.latency_us, off.gb_per_sec);
+
+                if (repl_supported) {
+                    prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+                    int ret = run_point(advices[a].advice, size, nthreads, num_nodes,
+                                        bytes_per_thread, &on);
+                    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+                    if (ret < 0) {
+                        printf(" FAIL: madvise failed with replication\n");
+                        return 1;
+                    }
+                    emit("on", advices[a].name, size, nthreads, &on);
+                    printf(" %10.2f %9.2f | %6.2f\n", on.latency_us, on.gb_per_sec,
+                           on.latency_us / off.latency_us);
+                } else {
+                    printf(" %10s %9s | %6s\n", "-", "-", "-");
+                }
+
+                if (nthreads == max_threads) {
+                    break;
+                }
+                nthreads = nthreads * 2 < max_threads ? nthreads * 2 : max_threads;
+            }
+        }
+    }
+
+    printf("\nBench7: DONE\n");
+    return mt_done();
+}
@@ -0,0 +1,255 @@
+// bench8.c - fork() latency from a replicated parent vs. RSS
+// Snapshot-style forks: the parent populates an anonymous heap (1MB to 32GB,
+// 4KB pages so the full PTE tree is copied), keeps helper threads reading it
+// from every node, and forks a child that records when it first runs and
+// then exits. Reports the parent-side fork() time, fork-to-child-running and
+// fork-to-child-exit for each replica count, and the ratio against the
+// replication-off parent.
+//
+// Usage: ./bench8 [max_rss_mb] [runs] [max_threads]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define MB (1024UL * 1024UL)
+#define GB (1024UL * MB)
+#define DEFAULT_RUNS 10
+#define MAX_CONFIGS 64
+#define MAX_THREADS 256
+
+enum { LAT_FORK, LAT_RUNNING, LAT_EXIT, NUM_LAT };
+static const char *lat_names[NUM_LAT] = { "fork", "running", "exit" };
+
+static const size_t rss_buckets[] = {
+    1 * MB, 16 * MB, 256 * MB, 1 * GB, 4 * GB, 16 * GB, 32 * GB
+};
+#define NUM_BUCKETS (sizeof(rss_buckets) / sizeof(rss_buckets[0]))
+
+typedef struct {
+    int node;
+    char *heap;
+    size_t size;
+} helper_t;
+
+static atomic_int stop_helpers;
+
+// Keeps the mm live on the helper's node so fork's COW write-protect has
+// remote TLBs to flush
+static void *helper_thread(void *arg) {
+    helper_t *h = (helper_t *)arg;
+    volatile char sink;
+
+    pin_to_node(h->node);
+    while (!atomic_load(&stop_helpers)) {
+        for (size_t off = 0; off < h->size && !atomic_load(&stop_helpers);
+             off += 64 * PAGE_SIZE) {
+            sink = h->heap[off];
+        }
+        (void)sink;
+        sched_yield();
+    }
+    return NULL;
+}
+
+// Times one fork; the child stamps *child_ts as soon as it runs
+static int fork_once(volatile uint64_t *child_ts, uint64_t out[NUM_LAT]) {
+    int status;
+
+    *child_ts = 0;
+    uint64_t t0 = mt_now_ns();
+    pid_t pid = fork();
+    if (pid == 0) {
+        *child_ts = mt_now_ns();
+        _exit(0);
+    }
+    uint64_t t1 = mt_now_ns();
+    if (pid < 0) {
+        return -1;
+    }
+    waitpid(pid, &status, 0);
+    uint64_t t2 = mt_now_ns();
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || *child_ts == 0) {
+        return -1;
+    }
+    out[LAT_FORK] = t1 - t0;
+    out[LAT_RUNNING] = *child_ts - t0;
+    out[LAT_EXIT] = t2 - t0;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    size_t max_rss = 32 * GB;
+    int runs = DEFAULT_RUNS;
+    int max_threads;
+    unsigned long masks[MAX_CONFIGS];
+    int num_configs = 0;
+    int num_nodes = 1;
+    uint64_t *samples[NUM_LAT];
+
+    max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 1) {
+        max_rss = strtoul(argv[1], NULL, 0) * MB;
+    }
+    if (argc > 2) {
+        runs = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        max_threads = atoi(argv[3]);
+    }
+    if (runs < 1) {
+        runs = 1;
+    }
+    if (max_threads < 1) {
+        max_threads = 1;
+    }
+    if (max_threads > MAX_THREADS) {
+        max_threads = MAX_THREADS;
+    }
+
+    mt_init("bench8");
+    printf("Bench8: fork() Latency from a Replicated Parent vs. RSS\n");
+    printf("=======================================================\n");
+
+    if (numa_available() >= 0) {
+        num_nodes = numa_num_configured_nodes();
+    }
+
+    // Replication off first, then 2..N node masks
+    masks[num_configs++] = 0;
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), baseline only\n", strerror(errno));
+    } else {
+        prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+        for (int w = 2; w <= num_nodes && num_configs < MAX_CONFIGS; w++) {
+            unsigned long mask = mt_node_mask(w);
+            if (mask) {
+                masks[num_configs++] = mask;
+            }
+        }
+    }
+
+    printf("INFO: %d NUMA nodes, %d runs per point, max RSS %zu MB, up to %d threads\n",
+           num_nodes, runs, max_rss / MB, max_threads);
+
+    volatile uint64_t *child_ts = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE,
+                                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    for (int l = 0; l < NUM_LAT; l++) {
+        samples[l] = calloc(runs, sizeof(uint64_t));
+    }
+    if (child_ts == MAP_FAILED || !samples[0] || !samples[1] || !samples[2]) {
+        printf("FAIL: Could not allocate sample buffers\n");
+        return 1;
+    }
+
+    for (size_t b = 0; b < NUM_BUCKETS; b++) {
+        size_t size = rss_buckets[b];
+
+        if (size > max_rss) {
+            break;
+        }
+        if (size > mt_available_memory() / 4 * 3) {
+            printf("\nNOTE: RSS %zu MB exceeds available memory, skipped\n", size / MB);
+            continue;
+        }
+
+        char *heap = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (heap == MAP_FAILED) {
+            printf("\nNOTE: mmap of %zu MB failed, skipped: %s\n", size / MB, strerror(errno));
+            continue;
+        }
+        madvise(heap, size, MADV_NOHUGEPAGE);
+        for (size_t off = 0; off < size; off += PAGE_SIZE) {
+            heap[off] = (char)(off >> 12);
+        }
+
+        for (int nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+            pthread_t threads[MAX_THREADS];
+            helper_t helpers[MAX_THREADS];
+            double base_p50 = 0;
+
+            // The forking main thread counts as one; helpers fill other nodes
+            atomic_store(&stop_helpers, 0);
+            for (int t = 1; t < nthreads; t++) {
+                helpers[t].node = t % num_nodes;
+                helpers[t].heap = heap;
+                helpers[t].size = size;
+                if (pthread_create(&threads[t], NULL, helper_thread, &helpers[t]) != 0) {
+                    printf("FAIL: Cannot create helper thread %d\n", t);
+                    return 1;
+                }
+            }
+
+            for (int c = 0; c < num_configs; c++) {
+                int replicas = 0;
+
+                if (masks[c]) {
+                    if (prctl(PR_SET_PGTABLE_REPL, masks[c], 0, 0, 0) < 0) {
+                        printf("\nNOTE: mask=0x%lx rejected (%s), skipped\n",
+                               masks[c], strerror(errno));
+                        continue;
+                    }
+                    replicas = __builtin_popcountl(prctl(PR_GET_PGTABLE_REPL, 0, 0, 0, 0));
+                }
+
+                for (int r = 0; r < runs; r++) {
+                    uint64_t lat[NUM_LAT];
+                    if (fork_once(child_ts, lat) < 0) {
+                        printf("FAIL: fork at RSS %zu MB failed: %s\n", size / MB, strerror(errno));
+                        return 1;
+                    }
+                    for (int l = 0; l < NUM_LAT; l++) {
+                        samples[l][r] = lat[l];
+                    }
+                }
+                prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+                printf("\nRSS %6zu MB  threads=%-3d replicas=%d (mask=0x%lx)\n",
+                       size / MB, nthreads, replicas, masks[c]);
+                for (int l = 0; l < NUM_LAT; l++) {
+                    char name[96];
+                    snprintf(name, sizeof(name), "rss%zumb_t%d_r%d_%s",
+                             size / MB, nthreads, replicas, lat_names[l]);
+                    mt_report_latency(name, lat_names[l], samples[l], runs);
+                }
+
+                // Samples are sorted now; compare medians against the off parent
+                double p50 = samples[LAT_FORK][(runs - 1) / 2];
+                if (c == 0) {
+                    base_p50 = p50;
+                } else if (base_p50 > 0) {
+                    printf("  fork p50 vs. replication off: %.2fx\n", p50 / base_p50);
+                }
+            }
+
+            atomic_store(&stop_helpers, 1);
+            for (int t = 1; t < nthreads; t++) {
+                pthread_join(threads[t], NULL);
+            }
+        }
+
+        munmap(heap, size);
+    }
+
+    for (int l = 0; l < NUM_LAT; l++) {
+        free(samples[l]);
+    }
+    munmap((void *)child_ts, PAGE_SIZE);
+
+    printf("\nBench8: DONE\n");
+    return mt_done();
+}
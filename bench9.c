@@ -0,0 +1,211 @@
+// bench9.c - Copy-on-write fault storm after fork from a replicated parent
+// Throughput version of test10. The parent dirties a large 4KB-page heap,
+// forks a child that just holds the COW references, then parent threads on
+// every node write-fault disjoint slices of the heap concurrently. Every
+// COW break has to update all replicas. Reports COW faults/sec and per-fault
+// latency percentiles with replication off and on.
+//
+// Usage: ./bench9 [size_mb] [max_threads]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mitosis_test.h"
+
+#define PAGE_SIZE 4096
+#define MB (1024UL * 1024UL)
+#define DEFAULT_SIZE (8192 * MB)
+#define MAX_THREADS 256
+
+typedef struct {
+    int node;
+    char *start;
+    size_t pages;
+    uint64_t *samples;
+    uint64_t start_ns;
+    uint64_t end_ns;
+} worker_t;
+
+static pthread_barrier_t start_barrier;
+
+static void *cow_thread(void *arg) {
+    worker_t *w = (worker_t *)arg;
+
+    pin_to_node(w->node);
+    pthread_barrier_wait(&start_barrier);
+
+    w->start_ns = mt_now_ns();
+    for (size_t p = 0; p < w->pages; p++) {
+        uint64_t t0 = mt_now_ns();
+        w->start[p * PAGE_SIZE] = 'P';
+        w->samples[p] = mt_now_ns() - t0;
+    }
+    w->end_ns = mt_now_ns();
+    return NULL;
+}
+
+// Forks a child holding the COW references, then storms the heap
+static int run_storm(char *heap, size_t pages, int nthreads, int num_nodes,
+                     uint64_t *samples, double *faults_per_sec) {
+    pthread_t threads[MAX_THREADS];
+    worker_t workers[MAX_THREADS];
+    uint64_t first_start = UINT64_MAX, last_end = 0;
+    int hold[2];
+    int status;
+    char c;
+
+    if (pipe(hold) < 0) {
+        return -1;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        return -1;
+    }
+    if (pid == 0) {
+        // Keep the shared pages referenced until the parent is done
+        close(hold[1]);
+        while (read(hold[0], &c, 1) > 0) {
+        }
+        _exit(0);
+    }
+    close(hold[0]);
+
+    size_t per_thread = pages / nthreads;
+    pthread_barrier_init(&start_barrier, NULL, nthreads);
+    for (int t = 0; t < nthreads; t++) {
+        size_t first = t * per_thread;
+        workers[t].node = t % num_nodes;
+        workers[t].start = heap + first * PAGE_SIZE;
+        workers[t].pages = (t == nthreads - 1) ? pages - first : per_thread;
+        workers[t].samples = samples + first;
+        if (pthread_create(&threads[t], NULL, cow_thread, &workers[t]) != 0) {
+            printf("FAIL: Cannot create thread %d\n", t);
+            exit(1);
+        }
+    }
+    for (int t = 0; t < nthreads; t++) {
+        pthread_join(threads[t], NULL);
+        if (workers[t].start_ns < first_start) {
+            first_start = workers[t].start_ns;
+        }
+        if (workers[t].end_ns > last_end) {
+            last_end = workers[t].end_ns;
+        }
+    }
+    pthread_barrier_destroy(&start_barrier);
+
+    close(hold[1]);
+    waitpid(pid, &status, 0);
+
+    *faults_per_sec = pages / ((last_end - first_start) / 1e9);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    size_t size = DEFAULT_SIZE;
+    int max_threads;
+    int num_nodes = 1;
+    int repl_supported = 1;
+
+    max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 1) {
+        size = strtoul(argv[1], NULL, 0) * MB;
+    }
+    if (argc > 2) {
+        max_threads = atoi(argv[2]);
+    }
+    if (max_threads < 1) {
+        max_threads = 1;
+    }
+    if (max_threads > MAX_THREADS) {
+        max_threads = MAX_THREADS;
+    }
+
+    mt_init("bench9");
+    printf("Bench9: COW Fault Storm after Fork from a Replicated Parent\n");
+    printf("===========================================================\n");
+
+    if (numa_available() >= 0) {
+        num_nodes = numa_num_configured_nodes();
+    }
+
+    // Breaking COW on every page doubles the footprint
+    if (size > mt_available_memory() / 3) {
+        size = mt_available_memory() / 3 / MB * MB;
+        printf("NOTE: Heap clamped to %zu MB by available memory\n", size / MB);
+    }
+    size_t pages = size / PAGE_SIZE;
+    if (pages == 0) {
+        printf("FAIL: Heap size too small\n");
+        return 1;
+    }
+
+    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
+        printf("NOTE: Replication unavailable (%s), replication-off only\n", strerror(errno));
+        repl_supported = 0;
+    }
+    prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+
+    printf("INFO: %d NUMA nodes, %zu MB heap (%zu pages), up to %d threads\n",
+           num_nodes, size / MB, pages, max_threads);
+
+    char *heap = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    uint64_t *samples = calloc(pages, sizeof(uint64_t));
+    if (heap == MAP_FAILED || !samples) {
+        printf("FAIL: Could not allocate heap or sample buffer\n");
+        return 1;
+    }
+    madvise(heap, size, MADV_NOHUGEPAGE);
+    for (size_t off = 0; off < size; off += PAGE_SIZE) {
+        heap[off] = (char)(off >> 12);
+    }
+
+    for (int nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+        double off_rate = 0;
+
+        for (int mode = 0; mode < 1 + repl_supported; mode++) {
+            const char *label = mode ? "on" : "off";
+            double rate;
+            char name[96];
+
+            if (mode) {
+                prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+            }
+            int ret = run_storm(heap, pages, nthreads, num_nodes, samples, &rate);
+            prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+            if (ret < 0) {
+                printf("FAIL: fork failed: %s\n", strerror(errno));
+                return 1;
+            }
+
+            printf("\nThreads %-3d replication %-3s %12.0f COW faults/s", nthreads, label, rate);
+            if (mode) {
+                printf("  (%.2fx off)", rate / off_rate);
+            } else {
+                off_rate = rate;
+            }
+            printf("\n");
+
+            snprintf(name, sizeof(name), "%s_t%d_faults", label, nthreads);
+            mt_metric(name, rate, "faults/s");
+            snprintf(name, sizeof(name), "%s_t%d_fault", label, nthreads);
+            mt_report_latency(name, "fault", samples, pages);
+        }
+    }
+
+    free(samples);
+    munmap(heap, size);
+
+    printf("\nBench9: DONE\n");
+    return mt_done();
+}
@@ -1,9 +1,4 @@
 #!/bin/bash
-set -e  # exit if any command fails
-
-for file in *.c; do
-    [ -e "$file" ] || continue  # skip if no .c files
-    output="${file%.c}"
-    echo "Compiling $file -> $output"
-    gcc "$file" -o "$output" -lnuma
-done
+# Kept for existing workflows: builds every test into build/ in parallel.
+# Use ./run_tests.sh to build and run the suite.
+exec "$(dirname "$0")/run_tests.sh" --build-only "$@"
@@ -0,0 +1,409 @@
+// mitosis_test.h - Shared helpers for Mitosis tests and benchmarks
+// Provides the prctl constants, check_replication(), pin_to_node(),
+// assertion macros, timing scopes and metric records. Records are emitted
+// in the format selected by MITOSIS_OUTPUT:
+//   text (default)  PASS:/FAIL: lines as the tests always printed
+//   tap             TAP version 13, metrics and scopes as "#" comments
+//   json            one JSON object per line, each starting with {"type":
+// Other printf output may be interleaved; TAP and JSON consumers skip it.
+// Include after #define _GNU_SOURCE (pin_to_node() needs cpu_set_t).
+//
+// Usage:
+//   mt_init("test1");
+//   MT_CHECK(ret == 0, "Initial state is disabled");
+//   MT_REQUIRE(ret >= 0, "PR_SET_PGTABLE_REPL enable");
+//   mt_scope_t s;
+//   mt_scope_begin(&s, "populate", 1);
+//   ... region ...
+//   mt_scope_end(&s);
+//   mt_metric("enable_p50", 12.5, "us");
+//   mt_report_latency("rss1mb_enable", "enable", samples_ns, runs);
+//   return mt_done();
+
+#ifndef MITOSIS_TEST_H
+#define MITOSIS_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <numa.h>
+#include "perf_counters.h"
+
+#define PR_SET_PGTABLE_REPL 100
+#define PR_GET_PGTABLE_REPL 101
+
+typedef enum { MT_TEXT, MT_TAP, MT_JSON } mt_format_t;
+
+static mt_format_t mt_format = MT_TEXT;
+static const char *mt_suite = "";
+static int mt_checks;
+static int mt_failures;
+
+static inline void mt_init(const char *suite) {
+    const char *env = getenv("MITOSIS_OUTPUT");
+
+    mt_suite = suite;
+    mt_checks = 0;
+    mt_failures = 0;
+
+    if (env && strcmp(env, "tap") == 0) {
+        mt_format = MT_TAP;
+        printf("TAP version 13\n");
+    } else if (env && strcmp(env, "json") == 0) {
+        mt_format = MT_JSON;
+    } else {
+        mt_format = MT_TEXT;
+    }
+}
+
+static inline uint64_t mt_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void mt_json_string(const char *s) {
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            printf("\\%c", *s);
+        } else if ((unsigned char)*s < 0x20) {
+            printf("\\u%04x", *s);
+        } else {
+            putchar(*s);
+        }
+    }
+    putchar('"');
+}
+
+// Returns ok so callers can branch on the result
+static inline int mt_check(int ok, const char *file, int line, const char *fmt, ...) {
+    char desc[256];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(desc, sizeof(desc), fmt, ap);
+    va_end(ap);
+
+    mt_checks++;
+    if (!ok) {
+        mt_failures++;
+    }
+
+    switch (mt_format) {
+    case MT_TAP:
+        printf("%s %d - %s", ok ? "ok" : "not ok", mt_checks, desc);
+        if (!ok) {
+            printf(" # %s:%d", file, line);
+        }
+        printf("\n");
+        break;
+    case MT_JSON:
+        printf("{\"type\": \"check\", \"suite\": ");
+        mt_json_string(mt_suite);
+        printf(", \"id\": %d, \"ok\": %s, \"desc\": ", mt_checks, ok ? "true" : "false");
+        mt_json_string(desc);
+        printf(", \"file\": ");
+        mt_json_string(file);
+        printf(", \"line\": %d}\n", line);
+        break;
+    default:
+        printf("%s: %s\n", ok ? "PASS" : "FAIL", desc);
+        break;
+    }
+    fflush(stdout);
+    return ok;
+}
+
+static inline void mt_metric(const char *name, double value, const char *unit) {
+    switch (mt_format) {
+    case MT_TAP:
+        printf("# metric %s %.6g %s\n", name, value, unit);
+        break;
+    case MT_JSON:
+        printf("{\"type\": \"metric\", \"suite\": ");
+        mt_json_string(mt_suite);
+        printf(", \"name\": ");
+        mt_json_string(name);
+        // JSON has no NaN/inf; ratios over a zero baseline come out as null
+        if (isfinite(value)) {
+            printf(", \"value\": %.6g, \"unit\": ", value);
+        } else {
+            printf(", \"value\": null, \"unit\": ");
+        }
+        mt_json_string(unit);
+        printf("}\n");
+        break;
+    default:
+        // Text output already prints its own tables
+        break;
+    }
+}
+
+static inline int mt_cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts ns samples in place, prints p50/p99/max in microseconds and emits
+// <prefix>_p50/_p99/_max metrics
+static inline void mt_report_latency(const char *prefix, const char *label,
+                                     uint64_t *samples, size_t n) {
+    char name[160];
+    double p50, p99, max;
+
+    if (n == 0) {
+        return;
+    }
+    qsort(samples, n, sizeof(uint64_t), mt_cmp_u64);
+    p50 = samples[(n - 1) * 50 / 100] / 1000.0;
+    p99 = samples[(n - 1) * 99 / 100] / 1000.0;
+    max = samples[n - 1] / 1000.0;
+
+    printf("  %-8s p50=%10.2f us  p99=%10.2f us  max=%10.2f us\n", label, p50, p99, max);
+
+    snprintf(name, sizeof(name), "%s_p50", prefix);
+    mt_metric(name, p50, "us");
+    snprintf(name, sizeof(name), "%s_p99", prefix);
+    mt_metric(name, p99, "us");
+    snprintf(name, sizeof(name), "%s_max", prefix);
+    mt_metric(name, max, "us");
+}
+
+// Free physical memory in bytes, for sizing benchmarks
+static inline size_t mt_available_memory(void) {
+    long pages = sysconf(_SC_AVPHYS_PAGES);
+    if (pages < 0) {
+        return 0;
+    }
+    return (size_t)pages * sysconf(_SC_PAGESIZE);
+}
+
+// Sums the "TLB:" row of /proc/interrupts (x86 shootdown IPIs), or -1
+static inline long long mt_tlb_shootdowns(void) {
+    FILE *f = fopen("/proc/interrupts", "r");
+    char line[8192];
+    long long total = -1;
+
+    if (!f) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char *p = line;
+        while (*p == ' ') {
+            p++;
+        }
+        if (strncmp(p, "TLB:", 4) != 0) {
+            continue;
+        }
+        p += 4;
+        total = 0;
+        for (;;) {
+            char *end;
+            long long v = strtoll(p, &end, 10);
+            if (end == p) {
+                break;
+            }
+            total += v;
+            p = end;
+        }
+        break;
+    }
+    fclose(f);
+    return total;
+}
+
+// Returns the kB value of a "Key:   123 kB" line in a /proc file, or -1
+static inline long mt_read_kb(const char *path, const char *key) {
+    FILE *f = fopen(path, "r");
+    char line[256];
+    long value = -1;
+    size_t len = strlen(key);
+
+    if (!f) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, key, len) == 0) {
+            value = strtol(line + len, NULL, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return value;
+}
+
+// Reads one counter from /proc/vmstat, or -1 if absent
+static inline long long mt_vmstat(const char *key) {
+    FILE *f = fopen("/proc/vmstat", "r");
+    char name[64];
+    long long value, found = -1;
+
+    if (!f) {
+        return -1;
+    }
+    while (fscanf(f, "%63s %lld", name, &value) == 2) {
+        if (strcmp(name, key) == 0) {
+            found = value;
+            break;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+// PR_SET_PGTABLE_REPL mask of the first `width` online nodes. Node IDs need
+// not be contiguous (offline or memoryless nodes); returns 0 if fewer than
+// `width` nodes fit in the mask.
+static inline unsigned long mt_node_mask(int width) {
+    unsigned long mask = 0;
+    int found = 0;
+
+    for (int n = 0; n < (int)(8 * sizeof(mask)) && found < width; n++) {
+        if (numa_bitmask_isbitset(numa_all_nodes_ptr, n)) {
+            mask |= 1UL << n;
+            found++;
+        }
+    }
+    return found == width ? mask : 0;
+}
+
+typedef struct {
+    const char *name;
+    uint64_t start_ns;
+    int with_counters;
+    perf_counters_t pc;
+} mt_scope_t;
+
+static inline void mt_scope_begin(mt_scope_t *s, const char *name, int with_counters) {
+    s->name = name;
+    s->with_counters = with_counters;
+    if (with_counters) {
+        perf_counters_open(&s->pc);
+        perf_counters_start(&s->pc);
+    }
+    s->start_ns = mt_now_ns();
+}
+
+// Emits a timing record (plus counters if requested) and returns the ns
+static inline uint64_t mt_scope_end(mt_scope_t *s) {
+    uint64_t ns = mt_now_ns() - s->start_ns;
+
+    if (s->with_counters) {
+        perf_counters_stop(&s->pc);
+    }
+
+    switch (mt_format) {
+    case MT_TAP:
+        printf("# scope %s %llu ns", s->name, (unsigned long long)ns);
+        for (int i = 0; s->with_counters && i < PERF_EV_COUNT; i++) {
+            if (s->pc.available[i]) {
+                printf(" %s=%llu", perf_counters_name(i),
+                       (unsigned long long)s->pc.value[i]);
+            }
+        }
+        printf("\n");
+        break;
+    case MT_JSON:
+        printf("{\"type\": \"scope\", \"suite\": ");
+        mt_json_string(mt_suite);
+        printf(", \"name\": ");
+        mt_json_string(s->name);
+        printf(", \"duration_ns\": %llu, \"counters\": {", (unsigned long long)ns);
+        for (int i = 0, first = 1; s->with_counters && i < PERF_EV_COUNT; i++) {
+            if (s->pc.available[i]) {
+                printf("%s\"%s\": %llu", first ? "" : ", ", perf_counters_name(i),
+                       (unsigned long long)s->pc.value[i]);
+                first = 0;
+            }
+        }
+        printf("}}\n");
+        break;
+    default:
+        printf("TIME [%s]: %.3f ms\n", s->name, ns / 1e6);
+        if (s->with_counters) {
+            perf_counters_print(&s->pc, s->name);
+        }
+        break;
+    }
+
+    if (s->with_counters) {
+        perf_counters_close(&s->pc);
+    }
+    return ns;
+}
+
+// Prints the plan/summary and returns the process exit code
+static inline int mt_done(void) {
+    switch (mt_format) {
+    case MT_TAP:
+        printf("1..%d\n", mt_checks);
+        break;
+    case MT_JSON:
+        printf("{\"type\": \"summary\", \"suite\": ");
+        mt_json_string(mt_suite);
+        printf(", \"checks\": %d, \"failures\": %d}\n", mt_checks, mt_failures);
+        break;
+    default:
+        break;
+    }
+    fflush(stdout);
+    return mt_failures ? 1 : 0;
+}
+
+#define MT_CHECK(cond, ...) mt_check(!!(cond), __FILE__, __LINE__, __VA_ARGS__)
+
+#define MT_REQUIRE(cond, ...)                                   \
+    do {                                                        \
+        if (!mt_check(!!(cond), __FILE__, __LINE__, __VA_ARGS__)) { \
+            exit(mt_done());                                    \
+        }                                                       \
+    } while (0)
+
+// Check replication status
+static inline int check_replication(const char *context) {
+    long status = prctl(PR_GET_PGTABLE_REPL, 0, 0, 0, 0);
+    if (status < 0) {
+        printf("[%s] FAIL: prctl(GET) failed: %s\n", context, strerror(errno));
+        return -1;
+    }
+    return (int)status;
+}
+
+// Pin to specific node
+static inline int pin_to_node(int node) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+
+    // Find CPUs on this node
+    struct bitmask *cpus = numa_allocate_cpumask();
+    if (numa_node_to_cpus(node, cpus) < 0) {
+        numa_free_cpumask(cpus);
+        return -1;
+    }
+
+    for (int cpu = 0; cpu < numa_num_configured_cpus(); cpu++) {
+        if (numa_bitmask_isbitset(cpus, cpu)) {
+            CPU_SET(cpu, &cpuset);
+        }
+    }
+
+    numa_free_cpumask(cpus);
+
+    if (sched_setaffinity(0, sizeof(cpuset), &cpuset) < 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+#endif // MITOSIS_TEST_H
@@ -0,0 +1,203 @@
+// perf_counters.h - perf_event_open instrumentation for tests and benchmarks
+// Wrap a region with perf_counters_start()/perf_counters_stop() to count
+// dTLB load misses, page-walk cycles (where the PMU exposes them), page
+// faults, minor/major faults and task-clock. Hardware events that cannot be
+// opened (VMs without a PMU, unknown CPUs) are dropped and the software
+// events still work. If perf_event_open is unavailable altogether, minor
+// and major faults fall back to getrusage().
+//
+// Counters are opened with inherit=1, so threads created after
+// perf_counters_open() are included in the totals.
+//
+// The page-walk event defaults to DTLB_LOAD_MISSES.WALK_PENDING on Intel;
+// set MITOSIS_WALK_EVENT=0x<raw config> to use another raw PMU event.
+//
+// Usage:
+//   perf_counters_t pc;
+//   perf_counters_open(&pc);
+//   perf_counters_start(&pc);
+//   ... region ...
+//   perf_counters_stop(&pc);
+//   perf_counters_print(&pc, "region");
+//   perf_counters_close(&pc);
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <linux/perf_event.h>
+
+enum {
+    PERF_EV_DTLB_MISSES,
+    PERF_EV_WALK_CYCLES,
+    PERF_EV_PAGE_FAULTS,
+    PERF_EV_MINOR_FAULTS,
+    PERF_EV_MAJOR_FAULTS,
+    PERF_EV_TASK_CLOCK,
+    PERF_EV_COUNT
+};
+
+typedef struct {
+    int fd[PERF_EV_COUNT];
+    uint64_t value[PERF_EV_COUNT];
+    int available[PERF_EV_COUNT];
+    int use_rusage;
+    struct rusage ru_start;
+} perf_counters_t;
+
+static inline long perf_event_open_sys(struct perf_event_attr *attr, pid_t pid,
+                                       int cpu, int group_fd, unsigned long flags) {
+    return syscall(__NR_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+// Returns the raw walk-cycles config, or 0 if this CPU has no known event
+static inline uint64_t perf_walk_event_config(void) {
+    const char *env = getenv("MITOSIS_WALK_EVENT");
+    if (env) {
+        return strtoull(env, NULL, 0);
+    }
+
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    char line[256];
+    int intel = 0;
+
+    if (!f) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "vendor_id", 9) == 0) {
+            intel = strstr(line, "GenuineIntel") != NULL;
+            break;
+        }
+    }
+    fclose(f);
+
+    // DTLB_LOAD_MISSES.WALK_PENDING: event 0x08, umask 0x10 (Skylake and later)
+    return intel ? 0x1008 : 0;
+}
+
+static inline int perf_open_event(uint32_t type, uint64_t config) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = 1;
+    attr.exclude_hv = 1;
+
+    return (int)perf_event_open_sys(&attr, 0, -1, -1, 0);
+}
+
+// Returns the number of events opened; 0 means the rusage fallback is used
+static inline int perf_counters_open(perf_counters_t *pc) {
+    uint64_t walk = perf_walk_event_config();
+    int opened = 0;
+
+    memset(pc, 0, sizeof(*pc));
+
+    pc->fd[PERF_EV_DTLB_MISSES] = perf_open_event(PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_DTLB |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    pc->fd[PERF_EV_WALK_CYCLES] = walk ? perf_open_event(PERF_TYPE_RAW, walk) : -1;
+    pc->fd[PERF_EV_PAGE_FAULTS] = perf_open_event(PERF_TYPE_SOFTWARE,
+                                                  PERF_COUNT_SW_PAGE_FAULTS);
+    pc->fd[PERF_EV_MINOR_FAULTS] = perf_open_event(PERF_TYPE_SOFTWARE,
+                                                   PERF_COUNT_SW_PAGE_FAULTS_MIN);
+    pc->fd[PERF_EV_MAJOR_FAULTS] = perf_open_event(PERF_TYPE_SOFTWARE,
+                                                   PERF_COUNT_SW_PAGE_FAULTS_MAJ);
+    pc->fd[PERF_EV_TASK_CLOCK] = perf_open_event(PERF_TYPE_SOFTWARE,
+                                                 PERF_COUNT_SW_TASK_CLOCK);
+
+    for (int i = 0; i < PERF_EV_COUNT; i++) {
+        pc->available[i] = pc->fd[i] >= 0;
+        opened += pc->available[i];
+    }
+
+    if (opened == 0) {
+        pc->use_rusage = 1;
+        pc->available[PERF_EV_MINOR_FAULTS] = 1;
+        pc->available[PERF_EV_MAJOR_FAULTS] = 1;
+    }
+    return opened;
+}
+
+static inline void perf_counters_start(perf_counters_t *pc) {
+    if (pc->use_rusage) {
+        getrusage(RUSAGE_SELF, &pc->ru_start);
+        return;
+    }
+    for (int i = 0; i < PERF_EV_COUNT; i++) {
+        if (pc->fd[i] >= 0) {
+            ioctl(pc->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+static inline void perf_counters_stop(perf_counters_t *pc) {
+    if (pc->use_rusage) {
+        struct rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        pc->value[PERF_EV_MINOR_FAULTS] = ru.ru_minflt - pc->ru_start.ru_minflt;
+        pc->value[PERF_EV_MAJOR_FAULTS] = ru.ru_majflt - pc->ru_start.ru_majflt;
+        return;
+    }
+    for (int i = 0; i < PERF_EV_COUNT; i++) {
+        if (pc->fd[i] < 0) {
+            continue;
+        }
+        ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(pc->fd[i], &pc->value[i], sizeof(uint64_t)) != sizeof(uint64_t)) {
+            pc->value[i] = 0;
+        }
+    }
+}
+
+static inline uint64_t perf_counters_get(const perf_counters_t *pc, int event) {
+    return pc->available[event] ? pc->value[event] : 0;
+}
+
+static inline const char *perf_counters_name(int event) {
+    static const char *names[PERF_EV_COUNT] = {
+        "dTLB-load-misses",
+        "walk-pending-cycles",
+        "page-faults",
+        "minor-faults",
+        "major-faults",
+        "task-clock-ns",
+    };
+    return names[event];
+}
+
+static inline void perf_counters_print(const perf_counters_t *pc, const char *label) {
+    printf("PERF [%s]%s\n", label, pc->use_rusage ? " (rusage fallback)" : "");
+    for (int i = 0; i < PERF_EV_COUNT; i++) {
+        if (pc->available[i]) {
+            printf("  %-20s %llu\n", perf_counters_name(i),
+                   (unsigned long long)pc->value[i]);
+        } else {
+            printf("  %-20s n/a\n", perf_counters_name(i));
+        }
+    }
+}
+
+static inline void perf_counters_close(perf_counters_t *pc) {
+    for (int i = 0; i < PERF_EV_COUNT; i++) {
+        if (pc->fd[i] >= 0) {
+            close(pc->fd[i]);
+            pc->fd[i] = -1;
+        }
+    }
+}
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,277 @@
+#!/bin/bash
+# run_tests.sh - Parallel build + test runner with JSON results
+#
+# Builds every *.c in parallel into $BUILD_DIR, then runs the tests. Isolated
+# tests run concurrently, each pinned to its own CPU (or NUMA node with
+# --pin node); tests listed in SERIAL_TESTS and all benchmarks run one at a
+# time afterwards, unpinned so their threads can spread across every node.
+# Every test gets a timeout. Results are written as JSON.
+#
+# Usage: ./run_tests.sh [options] [name ...]
+#   -j N           parallel build/run slots (default: nproc)
+#   -t SECS        per-test timeout (default: 120)
+#   -o FILE        JSON output (default: results.json)
+#   --pin MODE     cpu | node | none for the parallel phase (default: cpu)
+#   --bench        also run bench*.c (always serialized)
+#   --build-only   build and stop
+#   --format FMT   MITOSIS_OUTPUT for the tests: json | tap | text (default:
+#                  json; JSON records from mitosis_test.h are embedded in
+#                  each result)
+#   name ...       only build/run these (e.g. test14 bench2)
+#
+# Environment: CC, CFLAGS, LDLIBS, BUILD_DIR
+
+cd "$(dirname "$0")" || exit 1
+
+CC=${CC:-gcc}
+CFLAGS=${CFLAGS:--O2 -pthread}
+LDLIBS=${LDLIBS:--lnuma}
+BUILD_DIR=${BUILD_DIR:-build}
+JOBS=$(nproc)
+TIMEOUT=120
+OUTPUT=results.json
+PIN=cpu
+RUN_BENCH=0
+BUILD_ONLY=0
+FORMAT=json
+NAMES=()
+
+# Tests that lock large amounts of memory, fork many processes or bounce
+# threads across every node; running them next to others skews both.
+SERIAL_TESTS="test21 test25 test34 test35 test36"
+
+# Per-test timeout overrides (seconds)
+declare -A TIMEOUTS=(
+    [test15]=60   # known to hang in mremap
+    [test27]=60   # known to hang in MADV_DONTNEED
+)
+
+# Lines a test prints when it returns 0 without running
+SKIP_PATTERN='^SKIP:|^NUMA not available|^Need at least [0-9]+ NUMA nodes|^NOTE: userfaultfd not available'
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -j) JOBS=$2; shift ;;
+        -t) TIMEOUT=$2; shift ;;
+        -o) OUTPUT=$2; shift ;;
+        --pin) PIN=$2; shift ;;
+        --bench) RUN_BENCH=1 ;;
+        --build-only) BUILD_ONLY=1 ;;
+        --format) FORMAT=$2; shift ;;
+        -h|--help) sed -n '2,22p' "$0" | sed 's/^# \{0,1\}//'; exit 0 ;;
+        -*) echo "Unknown option: $1" >&2; exit 2 ;;
+        *) NAMES+=("${1%.c}") ;;
+    esac
+    shift
+done
+
+[ "$JOBS" -ge 1 ] 2>/dev/null || JOBS=1
+
+# Relative build dirs are run as ./dir/name; absolute ones as given
+case $BUILD_DIR in
+    /*) ;;
+    *) BUILD_DIR=./$BUILD_DIR ;;
+esac
+
+mkdir -p "$BUILD_DIR/logs" "$BUILD_DIR/results"
+rm -f "$BUILD_DIR"/results/*.json
+
+if [ ${#NAMES[@]} -eq 0 ]; then
+    for file in *.c; do
+        [ -e "$file" ] || continue
+        NAMES+=("${file%.c}")
+    done
+fi
+
+# Natural order: test2 before test10
+mapfile -t NAMES < <(printf '%s\n' "${NAMES[@]}" | sort -V)
+
+# Sets CHILD_MINFLT/CHILD_MAJFLT to the calling shell's cminflt/cmajflt.
+# Must not run inside $(...): a command substitution is its own process.
+read_child_faults() {
+    local stat fields
+    read -r stat < /proc/$BASHPID/stat
+    fields=(${stat##*) })
+    CHILD_MINFLT=${fields[8]}
+    CHILD_MAJFLT=${fields[10]}
+}
+
+json_str() {
+    local s=${1//\\/\\\\}
+    s=${s//\"/\\\"}
+    printf '"%s"' "$s"
+}
+
+# write_result name status exit_code wall_ms minor major [records]
+write_result() {
+    printf '{"name": %s, "status": "%s", "exit_code": %s, "wall_ms": %s, "minor_faults": %s, "major_faults": %s, "log": %s, "records": [%s]}' \
+        "$(json_str "$1")" "$2" "$3" "$4" "$5" "$6" \
+        "$(json_str "$BUILD_DIR/logs/$1.log")" "$7" > "$BUILD_DIR/results/$1.json"
+}
+
+# ---- Build ----------------------------------------------------------------
+
+build_one() {
+    local name=$1
+    if $CC $CFLAGS -I. "$name.c" -o "$BUILD_DIR/$name" $LDLIBS \
+            > "$BUILD_DIR/logs/$name.build.log" 2>&1; then
+        echo "Compiled $name.c -> $BUILD_DIR/$name"
+    else
+        echo "FAILED to compile $name.c (see $BUILD_DIR/logs/$name.build.log)"
+        write_result "$name" build_error null null null null
+        cp "$BUILD_DIR/logs/$name.build.log" "$BUILD_DIR/logs/$name.log"
+        return 1
+    fi
+}
+
+build_failed=0
+running=0
+for name in "${NAMES[@]}"; do
+    if [ ! -e "$name.c" ]; then
+        echo "No such source: $name.c" >&2
+        build_failed=1
+        continue
+    fi
+    build_one "$name" &
+    running=$((running + 1))
+    if [ $running -ge "$JOBS" ]; then
+        wait -n || build_failed=1
+        running=$((running - 1))
+    fi
+done
+while [ $running -gt 0 ]; do
+    wait -n || build_failed=1
+    running=$((running - 1))
+done
+
+if [ $BUILD_ONLY -eq 1 ]; then
+    exit $build_failed
+fi
+
+# ---- Run ------------------------------------------------------------------
+
+# Expands "0-3,8" into one id per line
+expand_list() {
+    local part
+    for part in ${1//,/ }; do
+        if [[ $part == *-* ]]; then
+            seq "${part%-*}" "${part#*-}"
+        else
+            echo "$part"
+        fi
+    done
+}
+
+mapfile -t CPUS < <(expand_list "$(cat /sys/devices/system/cpu/online)")
+mapfile -t NODES < <(expand_list "$(cat /sys/devices/system/node/online 2>/dev/null || echo 0)")
+
+# An empty slot means unpinned (the serial phase)
+pin_cmd() {
+    local slot=$1
+    [ -n "$slot" ] || return 0
+    case "$PIN" in
+        cpu) echo "taskset -c ${CPUS[$((slot % ${#CPUS[@]}))]}" ;;
+        node) echo "taskset -c $(cat /sys/devices/system/node/node${NODES[$((slot % ${#NODES[@]}))]}/cpulist)" ;;
+        *) echo "" ;;
+    esac
+}
+
+# Runs one test in a subshell; faults come from the subshell's reaped
+# children (cminflt/cmajflt in /proc/self/stat), so no external time(1).
+# Timing uses EPOCHREALTIME so nothing else is forked around the test.
+run_one() (
+    local name=$1 slot=$2
+    local limit=${TIMEOUTS[$name]:-$TIMEOUT}
+    local pin start end code status minflt majflt wall_ms
+
+    pin=$(pin_cmd "$slot")
+    read_child_faults
+    minflt=$CHILD_MINFLT
+    majflt=$CHILD_MAJFLT
+    start=${EPOCHREALTIME/[.,]/}
+    MITOSIS_OUTPUT=$FORMAT $pin timeout --kill-after=5 "$limit" "$BUILD_DIR/$name" \
+        > "$BUILD_DIR/logs/$name.log" 2>&1 < /dev/null
+    code=$?
+    end=${EPOCHREALTIME/[.,]/}
+    read_child_faults
+    wall_ms=$(((end - start) / 1000))
+
+    # 137 is any SIGKILL (e.g. the OOM killer); only --kill-after past the
+    # limit counts as a timeout
+    if [ $code -eq 124 ] || { [ $code -eq 137 ] && [ $wall_ms -ge $((limit * 1000)) ]; }; then
+        status=timeout
+    elif [ $code -ne 0 ]; then
+        status=fail
+    elif grep -qE "$SKIP_PATTERN" "$BUILD_DIR/logs/$name.log"; then
+        status=skip
+    else
+        status=pass
+    fi
+
+    write_result "$name" "$status" "$code" "$wall_ms" \
+        $((CHILD_MINFLT - minflt)) $((CHILD_MAJFLT - majflt)) \
+        "$(grep '^{"type": ' "$BUILD_DIR/logs/$name.log" | paste -sd, -)"
+    printf '%-8s %-8s %6d ms\n' "$name" "${status^^}" "$wall_ms"
+)
+
+parallel=()
+serial=()
+for name in "${NAMES[@]}"; do
+    [ -x "$BUILD_DIR/$name" ] || continue
+    if [[ $name == bench* ]]; then
+        [ $RUN_BENCH -eq 1 ] && serial+=("$name")
+    elif [[ " $SERIAL_TESTS " == *" $name "* ]]; then
+        serial+=("$name")
+    else
+        parallel+=("$name")
+    fi
+done
+
+# Slot i is busy while slot_pid[i] is alive
+declare -a slot_pid
+for name in "${parallel[@]}"; do
+    while true; do
+        free=-1
+        for ((i = 0; i < JOBS; i++)); do
+            if [ -z "${slot_pid[$i]}" ] || ! kill -0 "${slot_pid[$i]}" 2>/dev/null; then
+                free=$i
+                break
+            fi
+        done
+        [ $free -ge 0 ] && break
+        wait -n
+    done
+    run_one "$name" "$free" &
+    slot_pid[$free]=$!
+done
+wait
+
+for name in "${serial[@]}"; do
+    run_one "$name" ""
+done
+
+# ---- Report ---------------------------------------------------------------
+
+{
+    printf '{\n  "kernel": %s,\n  "host": %s,\n  "timestamp": %s,\n  "results": [\n' \
+        "$(json_str "$(uname -r)")" "$(json_str "$(uname -n)")" \
+        "$(json_str "$(date -u +%Y-%m-%dT%H:%M:%SZ)")"
+    first=1
+    for name in "${NAMES[@]}"; do
+        [ -e "$BUILD_DIR/results/$name.json" ] || continue
+        [ $first -eq 1 ] || printf ',\n'
+        printf '    %s' "$(cat "$BUILD_DIR/results/$name.json")"
+        first=0
+    done
+    printf '\n  ]\n}\n'
+} > "$OUTPUT"
+
+count() {
+    grep -l "\"status\": \"$1\"" "$BUILD_DIR"/results/*.json 2>/dev/null | wc -l
+}
+
+echo
+echo "pass=$(count pass) fail=$(count fail) skip=$(count skip) timeout=$(count timeout) build_error=$(count build_error)"
+echo "Results written to $OUTPUT"
+
+[ "$(count fail)" -eq 0 ] && [ "$(count timeout)" -eq 0 ] && [ $build_failed -eq 0 ]
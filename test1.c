@@ -5,68 +5,43 @@
 #include <sys/prctl.h>
 #include <errno.h>
 #include <string.h>
-
-#define PR_SET_PGTABLE_REPL 100
-#define PR_GET_PGTABLE_REPL 101
+#include "mitosis_test.h"
 
 int main(void) {
     long ret;
     
+    mt_init("test1");
     printf("TEST1: Basic Enable/Disable Mitosis Replication\n");
     printf("================================================\n");
     
     // Check initial state - should be disabled (0)
     ret = prctl(PR_GET_PGTABLE_REPL, 0, 0, 0, 0);
-    if (ret < 0) {
-        printf("FAIL: PR_GET_PGTABLE_REPL failed: %s\n", strerror(errno));
-        return 1;
-    }
-    if (ret != 0) {
-        printf("FAIL: Initial state should be 0 (disabled), but got %ld\n", ret);
-        return 1;
-    }
-    printf("PASS: Initial state is disabled (0)\n");
+    MT_REQUIRE(ret >= 0, "PR_GET_PGTABLE_REPL succeeds (%s)",
+               ret < 0 ? strerror(errno) : "ok");
+    MT_REQUIRE(ret == 0, "Initial state is disabled (got %ld)", ret);
     
     // Enable replication on all nodes
     ret = prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
-    if (ret < 0) {
-        printf("FAIL: PR_SET_PGTABLE_REPL enable failed: %s\n", strerror(errno));
-        return 1;
-    }
-    printf("PASS: Enabled replication\n");
+    MT_REQUIRE(ret >= 0, "Enabled replication (%s)",
+               ret < 0 ? strerror(errno) : "ok");
     
     // Verify it's enabled - should return non-zero bitmask
     ret = prctl(PR_GET_PGTABLE_REPL, 0, 0, 0, 0);
-    if (ret < 0) {
-        printf("FAIL: PR_GET_PGTABLE_REPL after enable failed: %s\n", strerror(errno));
-        return 1;
-    }
-    if (ret == 0) {
-        printf("FAIL: Should be enabled but got 0\n");
-        return 1;
-    }
-    printf("PASS: Replication is enabled (bitmask=0x%lx)\n", ret);
+    MT_REQUIRE(ret >= 0, "PR_GET_PGTABLE_REPL after enable succeeds (%s)",
+               ret < 0 ? strerror(errno) : "ok");
+    MT_REQUIRE(ret != 0, "Replication is enabled (bitmask=0x%lx)", ret);
     
     // Disable replication
     ret = prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
-    if (ret < 0) {
-        printf("FAIL: PR_SET_PGTABLE_REPL disable failed: %s\n", strerror(errno));
-        return 1;
-    }
-    printf("PASS: Disabled replication\n");
+    MT_REQUIRE(ret >= 0, "Disabled replication (%s)",
+               ret < 0 ? strerror(errno) : "ok");
     
     // Verify it's disabled
     ret = prctl(PR_GET_PGTABLE_REPL, 0, 0, 0, 0);
-    if (ret < 0) {
-        printf("FAIL: PR_GET_PGTABLE_REPL after disable failed: %s\n", strerror(errno));
-        return 1;
-    }
-    if (ret != 0) {
-        printf("FAIL: Should be disabled but got %ld\n", ret);
-        return 1;
-    }
-    printf("PASS: Replication is disabled (0)\n");
+    MT_REQUIRE(ret >= 0, "PR_GET_PGTABLE_REPL after disable succeeds (%s)",
+               ret < 0 ? strerror(errno) : "ok");
+    MT_REQUIRE(ret == 0, "Replication is disabled (got %ld)", ret);
     
     printf("\nTEST1: SUCCESS - All checks passed\n");
-    return 0;
+    return mt_done();
 }
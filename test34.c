@@ -11,9 +11,7 @@
 #include <errno.h>
 #include <string.h>
 #include <stdatomic.h>
-
-#define PR_SET_PGTABLE_REPL 100
-#define PR_GET_PGTABLE_REPL 101
+#include "mitosis_test.h"
 
 #define NUM_THREADS 4
 #define ITERATIONS 1000
@@ -47,30 +45,6 @@ static void trigger_page_walks(int iterations) {
     }
 }
 
-// Check replication status
-static int check_replication(const char *context) {
-    long status = prctl(PR_GET_PGTABLE_REPL, 0, 0, 0, 0);
-    if (status < 0) {
-        printf("[%s] FAIL: prctl(GET) failed: %s\n", context, strerror(errno));
-        return -1;
-    }
-    return (int)status;
-}
-
-// Pin thread to specific node
-static int pin_to_node(int node) {
-    struct bitmask *mask = numa_allocate_nodemask();
-    numa_bitmask_setbit(mask, node);
-    
-    if (numa_run_on_node_mask(mask) < 0) {
-        numa_free_nodemask(mask);
-        return -1;
-    }
-    
-    numa_free_nodemask(mask);
-    return 0;
-}
-
 // Thread worker function
 static void* thread_worker(void *arg) {
     thread_data_t *data = (thread_data_t*)arg;
@@ -202,6 +176,7 @@ int main() {
     pid_t child_pid;
     int num_nodes = numa_num_configured_nodes();
     
+    mt_init("test34");
     printf("=== MITOSIS THREAD-FORK REPLICATION TEST ===\n");
     printf("PID: %d\n", getpid());
     printf("NUMA nodes available: %d\n", num_nodes);
@@ -325,24 +300,20 @@ int main() {
     
     // FINAL RESULTS
     printf("\n=== FINAL RESULTS ===\n");
-    printf("Failures: %d\n", atomic_load(&results.failures));
-    printf("Parent post-fork threads OK: %d/%d\n", 
-           atomic_load(&results.parent_threads_ok), NUM_THREADS);
-    
     int child_ok = WIFEXITED(child_status) && WEXITSTATUS(child_status) == 0;
-    printf("Child test OK: %s (exit status: %d)\n", 
-           child_ok ? "YES" : "NO",
-           WIFEXITED(child_status) ? WEXITSTATUS(child_status) : -1);
     
-    int total_ok = (atomic_load(&results.failures) == 0) &&
-                   (atomic_load(&results.parent_threads_ok) == NUM_THREADS) &&
-                   child_ok;
+    MT_CHECK(atomic_load(&results.failures) == 0, "Failures: %d",
+             atomic_load(&results.failures));
+    MT_CHECK(atomic_load(&results.parent_threads_ok) == NUM_THREADS,
+             "Parent post-fork threads OK: %d/%d",
+             atomic_load(&results.parent_threads_ok), NUM_THREADS);
+    MT_CHECK(child_ok, "Child test OK (exit status: %d)",
+             WIFEXITED(child_status) ? WEXITSTATUS(child_status) : -1);
     
-    if (total_ok) {
+    if (mt_failures == 0) {
         printf("\n*** ALL TESTS PASSED ***\n");
-        return 0;
     } else {
         printf("\n*** TEST FAILED ***\n");
-        return 1;
     }
+    return mt_done();
 }
@@ -14,9 +14,7 @@
 #include <stdatomic.h>
 #include <signal.h>
 #include <sys/time.h>
-
-#define PR_SET_PGTABLE_REPL 100
-#define PR_GET_PGTABLE_REPL 101
+#include "mitosis_test.h"
 
 #define NUM_MIGRATION_THREADS 4
 #define NUM_FAULT_THREADS 4
@@ -46,49 +44,6 @@ typedef struct {
     enum { FAULT_THREAD, MIGRATION_THREAD } type;
 } thread_data_t;
 
-// Check replication status
-static int check_replication(const char *context, int expected) {
-    long status = prctl(PR_GET_PGTABLE_REPL, 0, 0, 0, 0);
-    if (status < 0) {
-        printf("[%s] ERROR: prctl(GET) failed: %s\n", context, strerror(errno));
-        return -1;
-    }
-    
-    if (expected >= 0 && status != expected) {
-        printf("[%s] ERROR: Expected repl=0x%x, got 0x%x\n", context, expected, (int)status);
-        return -1;
-    }
-    
-    return (int)status;
-}
-
-// Pin to specific node
-static int pin_to_node(int node) {
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    
-    // Find CPUs on this node
-    struct bitmask *cpus = numa_allocate_cpumask();
-    if (numa_node_to_cpus(node, cpus) < 0) {
-        numa_free_cpumask(cpus);
-        return -1;
-    }
-    
-    for (int cpu = 0; cpu < numa_num_configured_cpus(); cpu++) {
-        if (numa_bitmask_isbitset(cpus, cpu)) {
-            CPU_SET(cpu, &cpuset);
-        }
-    }
-    
-    numa_free_cpumask(cpus);
-    
-    if (sched_setaffinity(0, sizeof(cpuset), &cpuset) < 0) {
-        return -1;
-    }
-    
-    return 0;
-}
-
 // TEST 2: Thread that constantly faults pages
 static void* fault_thread(void *arg) {
     thread_data_t *data = (thread_data_t*)arg;
@@ -128,7 +83,7 @@ static void* fault_thread(void *arg) {
         
         // Occasionally check replication status
         if (faults % 500 == 0) {
-            if (check_replication(name, -1) < 0) {
+            if (check_replication(name) < 0) {
                 atomic_fetch_add(&stats.thread_failures, 1);
                 return NULL;
             }
@@ -193,7 +148,7 @@ static int child_process(int child_num, int parent_had_replication) {
     snprintf(name, sizeof(name), "Child%d", child_num);
     
     // Child should always start with replication disabled
-    int status = check_replication(name, 0);
+    int status = check_replication(name);
     if (status != 0) {
         printf("[%s] FAIL: Child should start with replication disabled\n", name);
         return 1;
@@ -208,7 +163,7 @@ static int child_process(int child_num, int parent_had_replication) {
         return 1;
     }
     
-    status = check_replication(name, -1);
+    status = check_replication(name);
     if (status <= 0) {
         printf("[%s] FAIL: Replication not enabled\n", name);
         return 1;
@@ -236,7 +191,9 @@ int main() {
     thread_data_t thread_data[NUM_FAULT_THREADS + NUM_MIGRATION_THREADS];
     pid_t child_pids[NUM_RAPID_FORKS];
     int num_nodes = numa_num_configured_nodes();
+    mt_scope_t stress;
     
+    mt_init("test35");
     printf("=== MITOSIS STRESS TEST ===\n");
     printf("PID: %d\n", getpid());
     printf("NUMA nodes: %d\n", num_nodes);
@@ -250,20 +207,16 @@ int main() {
     
     // Enable replication
     printf("\n=== ENABLING REPLICATION ===\n");
-    if (prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0) < 0) {
-        printf("FAIL: Cannot enable replication: %s\n", strerror(errno));
-        return 1;
-    }
-    
-    if (check_replication("Parent-Init", -1) <= 0) {
-        printf("FAIL: Replication not enabled\n");
-        return 1;
-    }
-    printf("PASS: Replication enabled\n");
+    int ret = prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+    MT_REQUIRE(ret == 0, "Enabled replication (%s)", ret < 0 ? strerror(errno) : "ok");
+    MT_REQUIRE(check_replication("Parent-Init") > 0, "Replication enabled in parent");
     
     // TEST 2 & 3: Start background threads before forking
     printf("\n=== STARTING BACKGROUND THREADS ===\n");
     
+    // Count walks and faults across the whole stress phase
+    mt_scope_begin(&stress, "stress phase", 1);
+    
     // Start fault threads
     for (int i = 0; i < NUM_FAULT_THREADS; i++) {
         thread_data[i].thread_id = i;
@@ -298,6 +251,7 @@ int main() {
     
     for (int i = 0; i < NUM_RAPID_FORKS; i++) {
         fork_in_progress = 1;
+        fflush(stdout);
         child_pids[i] = fork();
         
         if (child_pids[i] < 0) {
@@ -323,12 +277,11 @@ int main() {
         usleep(10000);
         
         // Verify parent replication still enabled
-        if (i % 5 == 0) {
-            if (check_replication("Parent-DuringForks", -1) <= 0) {
-                printf("FAIL: Parent lost replication during forks\n");
-                keep_running = 0;
-                break;
-            }
+        if (i % 5 == 0 &&
+            !MT_CHECK(check_replication("Parent-DuringForks") > 0,
+                      "Parent keeps replication after fork %d", i)) {
+            keep_running = 0;
+            break;
         }
     }
     
@@ -343,15 +296,9 @@ int main() {
     // TEST 4: Disable replication in parent AFTER forks
     printf("\n=== DISABLING PARENT REPLICATION ===\n");
     
-    if (prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0) < 0) {
-        printf("FAIL: Cannot disable replication: %s\n", strerror(errno));
-    } else {
-        if (check_replication("Parent-AfterDisable", 0) != 0) {
-            printf("FAIL: Replication not disabled\n");
-        } else {
-            printf("PASS: Parent replication disabled\n");
-        }
-    }
+    ret = prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+    MT_CHECK(ret == 0, "Disabled parent replication (%s)", ret < 0 ? strerror(errno) : "ok");
+    MT_CHECK(check_replication("Parent-AfterDisable") == 0, "Parent replication is disabled");
     
     // Stop threads
     printf("\n=== STOPPING THREADS ===\n");
@@ -367,6 +314,8 @@ int main() {
     
     printf("PASS: All threads stopped\n");
     
+    mt_scope_end(&stress);
+    
     // Wait for all children and verify they're unaffected
     printf("\n=== WAITING FOR CHILDREN ===\n");
     int children_ok = 0;
@@ -391,28 +340,27 @@ int main() {
     
     // FINAL RESULTS
     printf("\n=== FINAL RESULTS ===\n");
-    printf("Successful forks:      %d/%d\n", 
-           atomic_load(&stats.successful_forks), NUM_RAPID_FORKS);
-    printf("Failed forks:          %d\n", atomic_load(&stats.failed_forks));
-    printf("Thread failures:       %d\n", atomic_load(&stats.thread_failures));
+    MT_CHECK(atomic_load(&stats.successful_forks) == NUM_RAPID_FORKS,
+             "Successful forks: %d/%d", atomic_load(&stats.successful_forks), NUM_RAPID_FORKS);
+    MT_CHECK(atomic_load(&stats.failed_forks) == 0, "Failed forks: %d",
+             atomic_load(&stats.failed_forks));
+    MT_CHECK(atomic_load(&stats.thread_failures) == 0, "Thread failures: %d",
+             atomic_load(&stats.thread_failures));
+    MT_CHECK(children_failed == 0, "Children OK: %d/%d", children_ok, NUM_RAPID_FORKS);
+    
     printf("Migrations completed:  %d (expected ~%d)\n",
            atomic_load(&stats.migrations_completed),
            NUM_MIGRATION_THREADS * MIGRATION_CYCLES);
     printf("Page faults completed: %d (expected ~%d)\n",
            atomic_load(&stats.page_faults_completed),
            NUM_FAULT_THREADS * FAULT_ITERATIONS);
-    printf("Children OK:           %d/%d\n", children_ok, NUM_RAPID_FORKS);
+    mt_metric("migrations_completed", atomic_load(&stats.migrations_completed), "migrations");
+    mt_metric("page_faults_completed", atomic_load(&stats.page_faults_completed), "faults");
     
-    int all_ok = (atomic_load(&stats.failed_forks) == 0) &&
-                 (atomic_load(&stats.thread_failures) == 0) &&
-                 (children_failed == 0) &&
-                 (atomic_load(&stats.successful_forks) == NUM_RAPID_FORKS);
-    
-    if (all_ok) {
+    if (mt_failures == 0) {
         printf("\n*** ALL STRESS TESTS PASSED ***\n");
-        return 0;
     } else {
         printf("\n*** STRESS TEST FAILED ***\n");
-        return 1;
     }
+    return mt_done();
 }
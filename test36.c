@@ -0,0 +1,279 @@
+// test36.c - 1GB hugetlb pages (PUD-level mappings) with replication
+// Maps MAP_HUGETLB|MAP_HUGE_1GB regions, enables replication and checks that
+// every node's replica resolves the PUD entries to the same pages: data
+// written from one node is read back from every other, per-node writes are
+// visible everywhere, and mprotect/disable keep the mapping intact.
+// Skips when no 1GB pages are reserved, e.g. after
+//   echo 2 > /sys/kernel/mm/hugepages/hugepages-1048576kB/nr_hugepages
+//
+// Usage: ./test36 [--bench [accesses_millions]]
+//   --bench  also time a page-strided chase over the 1GB pages from every
+//            node with replication off and on
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+#include <numa.h>
+#include <errno.h>
+#include <stdint.h>
+#include "mitosis_test.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_1GB
+#define MAP_HUGE_1GB (30 << MAP_HUGE_SHIFT)
+#endif
+
+#define PAGE_SIZE 4096
+#define GB_PAGE_SIZE (1024UL * 1024UL * 1024UL)
+#define MAX_GB_PAGES 2
+#define MAGIC 0x6D69746F73697331ULL
+#define DEFAULT_ACCESSES_M 10
+#define FREE_PAGES_PATH "/sys/kernel/mm/hugepages/hugepages-1048576kB/free_hugepages"
+
+typedef struct {
+    int node;
+    char *mem;
+    size_t size;
+    int num_nodes;
+    uint64_t stamp_base;
+    long errors;
+} node_check_t;
+
+static long read_free_gb_pages(void) {
+    FILE *f = fopen(FREE_PAGES_PATH, "r");
+    long value = -1;
+
+    if (f) {
+        if (fscanf(f, "%ld", &value) != 1) {
+            value = -1;
+        }
+        fclose(f);
+    }
+    return value;
+}
+
+static uint64_t pattern(size_t off) {
+    return MAGIC ^ off;
+}
+
+// Verifies the main-thread pattern from this node, then stamps this node's
+// stripe: every num_nodes-th 4KB page, second word, with stamp_base + node + 1
+static void *node_check_thread(void *arg) {
+    node_check_t *c = (node_check_t *)arg;
+
+    if (pin_to_node(c->node) < 0) {
+        c->errors = -1;
+        return NULL;
+    }
+    for (size_t off = 0; off < c->size; off += PAGE_SIZE) {
+        if (*(uint64_t *)(c->mem + off) != pattern(off)) {
+            c->errors++;
+        }
+    }
+    for (size_t off = c->node * PAGE_SIZE; off < c->size; off += c->num_nodes * PAGE_SIZE) {
+        ((uint64_t *)(c->mem + off))[1] = c->stamp_base + c->node + 1;
+    }
+    return NULL;
+}
+
+// Each pass stamps new values, so a replica that missed a pass's writes
+// still shows the previous pass's stamps and fails the check
+static long check_from_every_node(char *mem, size_t size, int num_nodes, int pass) {
+    uint64_t stamp_base = (uint64_t)pass * num_nodes;
+    pthread_t threads[num_nodes];
+    node_check_t checks[num_nodes];
+    long errors = 0;
+
+    for (int n = 0; n < num_nodes; n++) {
+        checks[n] = (node_check_t){ n, mem, size, num_nodes, stamp_base, 0 };
+        if (pthread_create(&threads[n], NULL, node_check_thread, &checks[n]) != 0) {
+            return -1;
+        }
+    }
+    for (int n = 0; n < num_nodes; n++) {
+        pthread_join(threads[n], NULL);
+        if (checks[n].errors < 0) {
+            return -1;
+        }
+        errors += checks[n].errors;
+    }
+
+    // Every stripe written from its node must be visible here
+    for (size_t off = 0; off < size; off += PAGE_SIZE) {
+        uint64_t expected = stamp_base + (off / PAGE_SIZE) % num_nodes + 1;
+        if (((uint64_t *)(mem + off))[1] != expected) {
+            errors++;
+        }
+    }
+    return errors;
+}
+
+// Page-strided random chase; returns ns per access on the given node
+static double chase(char *mem, size_t size, int node, uint64_t accesses) {
+    size_t pages = size / PAGE_SIZE;
+    size_t idx = 0;
+
+    pin_to_node(node);
+    for (size_t i = 0; i < pages; i++) {
+        idx = ((uint64_t *)(mem + idx * PAGE_SIZE))[2];
+    }
+    uint64_t t0 = mt_now_ns();
+    for (uint64_t i = 0; i < accesses; i++) {
+        idx = ((volatile uint64_t *)(mem + idx * PAGE_SIZE))[2];
+    }
+    uint64_t ns = mt_now_ns() - t0;
+    pin_to_node(0);
+    return (double)ns / accesses;
+}
+
+// Third word of each 4KB page links a single random cycle (Sattolo)
+static int build_chain(char *mem, size_t size) {
+    size_t pages = size / PAGE_SIZE;
+    size_t *order = malloc(pages * sizeof(size_t));
+
+    if (!order) {
+        return -1;
+    }
+    for (size_t i = 0; i < pages; i++) {
+        order[i] = i;
+    }
+    srand48(0x5EED);
+    for (size_t i = pages - 1; i > 0; i--) {
+        size_t j = (size_t)(drand48() * i);
+        size_t tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    for (size_t i = 0; i < pages; i++) {
+        ((uint64_t *)(mem + order[i] * PAGE_SIZE))[2] = order[(i + 1) % pages];
+    }
+    free(order);
+    return 0;
+}
+
+static void run_bench(char *mem, size_t size, int num_nodes, uint64_t accesses) {
+    MT_REQUIRE(build_chain(mem, size) == 0, "Built chase permutation");
+
+    printf("\n--- Benchmark: 1GB-page chase, %llu accesses per node ---\n",
+           (unsigned long long)accesses);
+    printf("%-6s | %10s | %10s | %6s\n", "node", "off ns", "on ns", "on/off");
+    for (int n = 0; n < num_nodes; n++) {
+        char name[64];
+
+        prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+        double off = chase(mem, size, n, accesses);
+        prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+        double on = chase(mem, size, n, accesses);
+
+        printf("%-6d | %10.2f | %10.2f | %6.2f\n", n, off, on, on / off);
+        snprintf(name, sizeof(name), "off_node%d_ns_per_access", n);
+        mt_metric(name, off, "ns");
+        snprintf(name, sizeof(name), "on_node%d_ns_per_access", n);
+        mt_metric(name, on, "ns");
+    }
+}
+
+int main(int argc, char **argv) {
+    int bench = 0;
+    uint64_t accesses = DEFAULT_ACCESSES_M * 1000000ULL;
+    long ret;
+
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        bench = 1;
+        if (argc > 2) {
+            accesses = strtoull(argv[2], NULL, 0) * 1000000ULL;
+        }
+    }
+
+    mt_init("test36");
+    printf("TEST36: 1GB Hugetlb Pages (PUD-level) with Replication\n");
+    printf("======================================================\n");
+
+    if (numa_available() < 0) {
+        printf("NUMA not available, skipping test\n");
+        return 0;
+    }
+    int num_nodes = numa_num_configured_nodes();
+
+    long free_pages = read_free_gb_pages();
+    if (free_pages < 1) {
+        printf("SKIP: No free 1GB huge pages reserved (%s = %ld)\n", FREE_PAGES_PATH, free_pages);
+        return 0;
+    }
+    size_t num_pages = free_pages < MAX_GB_PAGES ? free_pages : MAX_GB_PAGES;
+    size_t size = num_pages * GB_PAGE_SIZE;
+
+    char *mem = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_1GB, -1, 0);
+    if (mem == MAP_FAILED) {
+        printf("SKIP: MAP_HUGE_1GB mmap of %zu pages failed: %s\n", num_pages, strerror(errno));
+        return 0;
+    }
+    printf("INFO: %d NUMA nodes, %zu x 1GB pages at %p\n", num_nodes, num_pages, mem);
+    MT_CHECK(((uintptr_t)mem & (GB_PAGE_SIZE - 1)) == 0, "Mapping is 1GB aligned");
+
+    ret = prctl(PR_SET_PGTABLE_REPL, 1, 0, 0, 0);
+    MT_REQUIRE(ret >= 0, "Enabled replication (%s)", ret < 0 ? strerror(errno) : "ok");
+    ret = prctl(PR_GET_PGTABLE_REPL, 0, 0, 0, 0);
+    MT_REQUIRE(ret > 0, "Replication is enabled (bitmask=0x%lx)", ret);
+
+    // Fault the 1GB pages in from node 0 while replicated
+    pin_to_node(0);
+    for (size_t off = 0; off < size; off += PAGE_SIZE) {
+        *(uint64_t *)(mem + off) = pattern(off);
+    }
+    long after_fault = read_free_gb_pages();
+    MT_CHECK(after_fault == free_pages - (long)num_pages,
+             "Faulting consumed %zu 1GB pages (free %ld -> %ld)",
+             num_pages, free_pages, after_fault);
+
+    long errors = check_from_every_node(mem, size, num_nodes, 0);
+    MT_CHECK(errors == 0, "Pattern and per-node stripes consistent on all %d nodes (%ld errors)",
+             num_nodes, errors);
+
+    // Protection change rewrites the PUD entry in every replica
+    ret = mprotect(mem, size, PROT_READ);
+    MT_CHECK(ret == 0, "mprotect(PROT_READ) on 1GB pages (%s)", ret < 0 ? strerror(errno) : "ok");
+    errors = 0;
+    for (size_t off = 0; off < size; off += PAGE_SIZE) {
+        if (*(uint64_t *)(mem + off) != pattern(off)) {
+            errors++;
+        }
+    }
+    MT_CHECK(errors == 0, "Data readable after mprotect (%ld errors)", errors);
+    ret = mprotect(mem, size, PROT_READ | PROT_WRITE);
+    MT_CHECK(ret == 0, "mprotect(PROT_READ|PROT_WRITE) restores write access");
+    errors = check_from_every_node(mem, size, num_nodes, 1);
+    MT_CHECK(errors == 0, "All nodes consistent after mprotect round trip (%ld errors)", errors);
+
+    if (bench) {
+        run_bench(mem, size, num_nodes, accesses);
+    }
+
+    ret = prctl(PR_SET_PGTABLE_REPL, 0, 0, 0, 0);
+    MT_CHECK(ret == 0, "Disabled replication (%s)", ret < 0 ? strerror(errno) : "ok");
+    errors = 0;
+    for (size_t off = 0; off < size; off += PAGE_SIZE) {
+        if (*(uint64_t *)(mem + off) != pattern(off)) {
+            errors++;
+        }
+    }
+    MT_CHECK(errors == 0, "Data intact after disable (%ld errors)", errors);
+
+    munmap(mem, size);
+    MT_CHECK(read_free_gb_pages() == free_pages, "1GB pages returned to the pool after munmap");
+
+    if (mt_failures == 0) {
+        printf("\nTEST36: SUCCESS - 1GB pages work correctly with replication\n");
+    } else {
+        printf("\nTEST36: FAILED\n");
+    }
+    return mt_done();
+}